@@ -20,7 +20,10 @@ struct fragment_shader_payload
 	Vec3f color; // 片元颜色，由顶点着色器计算并传递给片元着色器
 	Vec3f normal; // 片元法向量，用于计算光照等效果
 	Vec2f tex_coords; // 纹理坐标，用于从纹理中采样颜色
-	Texture* texture; // 指向纹理对象的指针，用于在片元着色器中对纹理进行采样
+	Vec2f tex_coords_dx; // 屏幕 x 方向移动一个像素时纹理坐标的变化，用于选择 mip 级别
+	Vec2f tex_coords_dy; // 屏幕 y 方向移动一个像素时纹理坐标的变化
+	const Texture* texture; // 指向纹理对象的指针，用于在片元着色器中对纹理进行采样
+	Sampler sampler; // 绑定纹理时指定的采样器状态，采样 texture 时传给 sample、fetch
 	Vec3f flatNormal; // 三角形面法向量
 
 	/**
@@ -37,7 +40,7 @@ struct fragment_shader_payload
 	 * @param texCoord 纹理坐标
 	 * @param tex 指向纹理对象的指针
 	 */
-	fragment_shader_payload(const Vec3f& _color, const Vec3f& _normal, const Vec2f& texCoord, Texture* tex)
+	fragment_shader_payload(const Vec3f& _color, const Vec3f& _normal, const Vec2f& texCoord, const Texture* tex)
 		:color(_color), normal(_normal), tex_coords(texCoord), texture(tex) {}
 
 	/**
@@ -48,6 +51,6 @@ struct fragment_shader_payload
 	 * @param tex 指向纹理对象的指针
 	 * @param _flatNormal 三角形面法向量
 	 */
-	fragment_shader_payload(const Vec3f& _color, const Vec3f& _normal, const Vec2f& texCoord, Texture* tex, const Vec3f& _flatNormal)
+	fragment_shader_payload(const Vec3f& _color, const Vec3f& _normal, const Vec2f& texCoord, const Texture* tex, const Vec3f& _flatNormal)
 		:color(_color), normal(_normal), tex_coords(texCoord), texture(tex), flatNormal(_flatNormal) {}
 };
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "Texture.h"
+
+namespace {
+
+	/**
+	 * @brief 按寻址方式把纹理坐标的一个分量折回有效范围。重复时只保留小数部分，截断时限制在 [-1, 2] 内，
+	 * 乘以纹理尺寸后都不会溢出 int；不是有限值的坐标当作 0。
+	 */
+	float wrap_coordinate(float u, TextureWrap mode) {
+		if (!std::isfinite(u)) return 0.f;
+		if (mode == TextureWrap::Repeat) return u - std::floor(u);
+		return std::min(std::max(u, -1.f), 2.f);
+	}
+
+	/**
+	 * @brief 按寻址方式把纹素坐标折回 [0, size)。经过 wrap_coordinate 之后，重复寻址的纹素坐标只会比有效范围多出一个纹素，
+	 * 用比较代替取模就够了。
+	 */
+	int wrap_texel(int i, int size, TextureWrap mode) {
+		if (mode == TextureWrap::Clamp) return std::min(std::max(i, 0), size - 1);
+		if (i < 0) return i + size;
+		return i >= size ? i - size : i;
+	}
+
+	/**
+	 * @brief sRGB 编码的分量转换到线性空间。
+	 */
+	float srgb_to_linear(float c) {
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	uint8_t quantize(float c) {
+		return static_cast<uint8_t>(std::min(std::max(c, 0.f), 1.f) * 255.f + 0.5f);
+	}
+
+	/**
+	 * @brief 2x2 纹素的平均。8 位分量按四舍五入取整。
+	 */
+	uint8_t average(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+		return static_cast<uint8_t>((a + b + c + d + 2) >> 2);
+	}
+
+	float average(float a, float b, float c, float d) {
+		return (a + b + c + d) * 0.25f;
+	}
+
+	Vec4f lerp(const Vec4f& a, const Vec4f& b, float t) {
+		return a + (b - a) * t;
+	}
+
+} // namespace
+
+Texture::Texture(const char* filename, TexelFormat format, TextureColorSpace color_space)
+	: format(format), color_space(color_space), width(0), height(0) {
+	TGAImage image_data;
+	if (!image_data.read_tga_file(filename)) return;
+	image_data.flip_vertically();
+
+	width = image_data.get_width();
+	height = image_data.get_height();
+
+	// 先统一转换成 RGBA8，灰度图复制到三个通道，没有 alpha 通道时 alpha 为 255
+	std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+	const int bytespp = image_data.get_bytespp();
+	const unsigned char* src = image_data.buffer();
+	for (size_t i = 0; i < static_cast<size_t>(width) * height; i++) {
+		const unsigned char* p = src + i * bytespp;
+		uint8_t* q = &rgba[i * 4];
+		if (bytespp >= 3) {
+			q[0] = p[2];
+			q[1] = p[1];
+			q[2] = p[0];
+			q[3] = bytespp == 4 ? p[3] : 255;
+		}
+		else {
+			q[0] = q[1] = q[2] = p[0];
+			q[3] = 255;
+		}
+	}
+	convert(width, height, rgba.data());
+}
+
+Texture::Texture(int width, int height, const uint8_t* rgba, TexelFormat format, TextureColorSpace color_space)
+	: format(format), color_space(color_space), width(width), height(height) {
+	if (width <= 0 || height <= 0) {
+		this->width = this->height = 0;
+		return;
+	}
+	convert(width, height, rgba);
+}
+
+void Texture::convert(int w, int h, const uint8_t* rgba) {
+	const size_t count = static_cast<size_t>(w) * h * 4;
+	if (format == TexelFormat::RGBA8 && color_space == TextureColorSpace::Linear) {
+		build_mips(w, h, std::vector<uint8_t>(rgba, rgba + count));
+		return;
+	}
+
+	// 8 位分量只有 256 种取值，先查表得到 [0, 1] 内的（线性）值，再按格式存储
+	float decode[256], unorm[256];
+	for (int i = 0; i < 256; i++) {
+		unorm[i] = i / 255.f;
+		decode[i] = color_space == TextureColorSpace::SRGB ? srgb_to_linear(unorm[i]) : unorm[i];
+	}
+	std::vector<float> rows(count);
+	for (size_t i = 0; i < count; i += 4) {
+		rows[i] = decode[rgba[i]];
+		rows[i + 1] = decode[rgba[i + 1]];
+		rows[i + 2] = decode[rgba[i + 2]];
+		rows[i + 3] = unorm[rgba[i + 3]];
+	}
+	if (format == TexelFormat::RGBA32F) {
+		build_mips(w, h, std::move(rows));
+		return;
+	}
+	// sRGB 转换后存成 RGBA8 时暗部的精度会下降，需要精度时用 RGBA32F
+	std::vector<uint8_t> bytes(count);
+	std::transform(rows.begin(), rows.end(), bytes.begin(), quantize);
+	build_mips(w, h, std::move(bytes));
+}
+
+template <typename T>
+void Texture::build_mips(int w, int h, std::vector<T> rows) {
+	// 每个纹素是上一级对应 2x2 纹素的平均，尺寸为奇数时上一级的最后一行（列）被舍去，对常见的 2 的幂尺寸没有影响。
+	// 在按行排列的数据上逐级计算，每一级算完后再按 layout 存储
+	const size_t bytes = texel_bytes(format);
+	mips.clear();
+	mips.push_back(store_level(w, h, reinterpret_cast<const uint8_t*>(rows.data()), bytes, layout));
+	while (w > 1 || h > 1) {
+		const int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+		std::vector<T> next(static_cast<size_t>(nw) * nh * 4);
+		for (int y = 0; y < nh; y++) {
+			const int y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+			for (int x = 0; x < nw; x++) {
+				const int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+				const T* a = &rows[(static_cast<size_t>(y0) * w + x0) * 4];
+				const T* b = &rows[(static_cast<size_t>(y0) * w + x1) * 4];
+				const T* c = &rows[(static_cast<size_t>(y1) * w + x0) * 4];
+				const T* d = &rows[(static_cast<size_t>(y1) * w + x1) * 4];
+				T* q = &next[(static_cast<size_t>(y) * nw + x) * 4];
+				for (int k = 0; k < 4; k++) {
+					q[k] = average(a[k], b[k], c[k], d[k]);
+				}
+			}
+		}
+		rows = std::move(next);
+		w = nw;
+		h = nh;
+		mips.push_back(store_level(w, h, reinterpret_cast<const uint8_t*>(rows.data()), bytes, layout));
+	}
+}
+
+Texture::MipLevel Texture::store_level(int w, int h, const uint8_t* rows, size_t bytes, TextureLayout layout) {
+	MipLevel level;
+	level.width = w;
+	level.height = h;
+	level.tiles_x = (w + tile_size - 1) / tile_size;
+	const int tiles_y = (h + tile_size - 1) / tile_size;
+	// Tiled 布局按整块分配，分块多出来的部分不会被读到
+	const size_t texels = layout == TextureLayout::Tiled
+		? static_cast<size_t>(level.tiles_x) * tiles_y * tile_size * tile_size : static_cast<size_t>(w) * h;
+	level.lines.resize((texels * bytes + sizeof(TexelLine) - 1) / sizeof(TexelLine));
+	uint8_t* dst = level.texels();
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			std::copy_n(rows + (static_cast<size_t>(y) * w + x) * bytes, bytes, dst + texel_index(level, layout, x, y) * bytes);
+		}
+	}
+	return level;
+}
+
+std::vector<uint8_t> Texture::load_level(const MipLevel& level, size_t bytes, TextureLayout layout) {
+	std::vector<uint8_t> rows(static_cast<size_t>(level.width) * level.height * bytes);
+	const uint8_t* src = level.texels();
+	for (int y = 0; y < level.height; y++) {
+		for (int x = 0; x < level.width; x++) {
+			std::copy_n(src + texel_index(level, layout, x, y) * bytes, bytes, &rows[(static_cast<size_t>(y) * level.width + x) * bytes]);
+		}
+	}
+	return rows;
+}
+
+void Texture::set_layout(TextureLayout new_layout) {
+	if (new_layout == layout) return;
+	const size_t bytes = texel_bytes(format);
+	for (MipLevel& level : mips) {
+		std::vector<uint8_t> rows = load_level(level, bytes, layout);
+		level = store_level(level.width, level.height, rows.data(), bytes, new_layout);
+	}
+	layout = new_layout;
+}
+
+Vec4f Texture::fetch_texel(const MipLevel& level, size_t index) const {
+	if (format == TexelFormat::RGBA32F) {
+		const float* p = reinterpret_cast<const float*>(level.texels()) + index * 4;
+		return Vec4f(p[0], p[1], p[2], p[3]);
+	}
+	const uint8_t* p = level.texels() + index * 4;
+	const float scale = 1.f / 255.f;
+	return Vec4f(p[0] * scale, p[1] * scale, p[2] * scale, p[3] * scale);
+}
+
+Vec4f Texture::sample_level(int level, const Vec2f& uv, bool bilinear, const Sampler& sampler) const {
+	const MipLevel& m = mips[level];
+	const float x = wrap_coordinate(uv.x, sampler.wrap_u) * m.width;
+	const float y = wrap_coordinate(uv.y, sampler.wrap_v) * m.height;
+	if (!bilinear) {
+		const int i = wrap_texel(static_cast<int>(std::floor(x)), m.width, sampler.wrap_u);
+		const int j = wrap_texel(static_cast<int>(std::floor(y)), m.height, sampler.wrap_v);
+		return fetch_texel(m, texel_index(m, layout, i, j));
+	}
+
+	// 纹素中心在 (i + 0.5, j + 0.5)，取包围采样点的 4 个纹素中心插值
+	const float fx = std::floor(x - 0.5f), fy = std::floor(y - 0.5f);
+	const float tx = x - 0.5f - fx, ty = y - 0.5f - fy;
+	const size_t c0 = column_offset(layout, wrap_texel(static_cast<int>(fx), m.width, sampler.wrap_u));
+	const size_t c1 = column_offset(layout, wrap_texel(static_cast<int>(fx) + 1, m.width, sampler.wrap_u));
+	const size_t r0 = row_offset(m, layout, wrap_texel(static_cast<int>(fy), m.height, sampler.wrap_v));
+	const size_t r1 = row_offset(m, layout, wrap_texel(static_cast<int>(fy) + 1, m.height, sampler.wrap_v));
+	const Vec4f bottom = lerp(fetch_texel(m, r0 + c0), fetch_texel(m, r0 + c1), tx);
+	const Vec4f top = lerp(fetch_texel(m, r1 + c0), fetch_texel(m, r1 + c1), tx);
+	return lerp(bottom, top, ty);
+}
+
+float Texture::compute_lod(const Vec2f& duv_dx, const Vec2f& duv_dy, const Sampler& sampler) const {
+	// 导数换算成原图中的纹素数，rho² 取两个方向中较大的，log2(rho) = 0.5 * log2(rho²)
+	const float dx_u = duv_dx.x * width, dx_v = duv_dx.y * height;
+	const float dy_u = duv_dy.x * width, dy_v = duv_dy.y * height;
+	const float rho2 = std::max(dx_u * dx_u + dx_v * dx_v, dy_u * dy_u + dy_v * dy_v);
+	return 0.5f * std::log2(rho2) + sampler.lod_bias;
+}
+
+Vec4f Texture::sample(const Vec2f& uv, float lod, const Sampler& sampler) const {
+	if (mips.empty()) return Vec4f(0.f, 0.f, 0.f, 0.f);
+	const int last = mip_count() - 1;
+	// 放大时（lod <= 0）使用原图，NaN 也当作原图
+	lod = lod > 0 ? std::min(lod, static_cast<float>(last)) : 0.f;
+
+	switch (sampler.filter) {
+	case TextureFilter::Nearest:
+		return sample_level(static_cast<int>(lod + 0.5f), uv, false, sampler);
+	case TextureFilter::Bilinear:
+		return sample_level(static_cast<int>(lod + 0.5f), uv, true, sampler);
+	case TextureFilter::Trilinear:
+	default: {
+		const int level = static_cast<int>(lod);
+		const float t = lod - level;
+		const Vec4f fine = sample_level(level, uv, true, sampler);
+		if (t == 0.f || level == last) return fine;
+		return lerp(fine, sample_level(level + 1, uv, true, sampler), t);
+	}
+	}
+}
+
+Vec4f Texture::sample(const Vec2f& uv, const Vec2f& duv_dx, const Vec2f& duv_dy, const Sampler& sampler) const {
+	return sample(uv, compute_lod(duv_dx, duv_dy, sampler), sampler);
+}
+
+Vec4f Texture::fetch(float u, float v, const Sampler& sampler) const {
+	if (mips.empty()) return Vec4f(0.f, 0.f, 0.f, 0.f);
+	const MipLevel& m = mips[0];
+	const int x = wrap_texel(static_cast<int>(std::floor(wrap_coordinate(u, sampler.wrap_u) * m.width)), m.width, sampler.wrap_u);
+	const int y = wrap_texel(static_cast<int>(std::floor(wrap_coordinate(v, sampler.wrap_v) * m.height)), m.height, sampler.wrap_v);
+	return fetch_texel(m, texel_index(m, layout, x, y));
+}
+
+TGAColor Texture::getColor(float u, float v, const Sampler& sampler) const {
+	if (mips.empty()) return TGAColor();
+	const Vec4f c = fetch(u, v, sampler);
+	return TGAColor(quantize(c.x), quantize(c.y), quantize(c.z), quantize(c.w));
+}
+
+TextureBenchmark benchmark_texture_fetch(const Texture& texture, long long sample_count, float angle, const Sampler& sampler) {
+	TextureBenchmark result;
+	if (texture.mip_count() == 0 || sample_count <= 0) return result;
+	// 屏幕上的正方形边长与纹理宽度相同，像素 (i, j) 绕中心旋转 angle 后映射到纹理坐标
+	const int size = texture.width;
+	const float c = std::cos(angle) / size, s = std::sin(angle) / size;
+	const int block = 8;
+	double sum = 0;
+	long long done = 0;
+	auto start = std::chrono::steady_clock::now();
+	while (done < sample_count) {
+		for (int by = 0; by < size && done < sample_count; by += block) {
+			for (int bx = 0; bx < size && done < sample_count; bx += block) {
+				for (int j = by; j < std::min(by + block, size); j++) {
+					for (int i = bx; i < std::min(bx + block, size); i++) {
+						const float x = i + 0.5f - size * 0.5f, y = j + 0.5f - size * 0.5f;
+						const Vec2f uv(0.5f + c * x - s * y, 0.5f + s * x + c * y);
+						sum += texture.sample(uv, 0.f, sampler).x;
+					}
+				}
+				done += static_cast<long long>(std::min(block, size - bx)) * std::min(block, size - by);
+			}
+		}
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.samples = done;
+	result.checksum = sum;
+	return result;
+}
@@ -1,22 +1,268 @@
 #pragma once
 
+#include <vector>
+#include <cstdint>
+
+#include "geometry.h"
 #include "tgaimage.h"
 
+/**
+
+@brief 纹理坐标超出 [0, 1] 时的寻址方式。
+*/
+enum class TextureWrap
+{
+	Repeat, // 重复：只取小数部分，纹理在两个方向上平铺
+	Clamp   // 截断：取最靠近的边缘纹素
+};
+
+/**
+
+@brief 纹理过滤方式。
+*/
+enum class TextureFilter
+{
+	Nearest,   // 最近的 mip 级别中最近的纹素
+	Bilinear,  // 最近的 mip 级别中相邻 4 个纹素的双线性插值
+	Trilinear  // 相邻两个 mip 级别分别做双线性插值，再按 LOD 的小数部分插值
+};
+
+/**
+
+@brief 纹素在内存中的排列方式。
+*/
+enum class TextureLayout
+{
+	Linear, // 按行排列，纹理坐标沿 v 方向移动一个纹素就跨过一整行
+	Tiled   // 4x4 纹素为一个分块，一个分块 64 字节正好是一条缓存行，分块按行排列；双线性过滤的 2x2 纹素大多落在同一条缓存行中
+};
+
+/**
+
+@brief 纹素在内存中的格式。加载时统一转换成其中一种，采样时一次读出可以直接使用的 RGBA。
+*/
+enum class TexelFormat
+{
+	RGBA8,  // 每个分量 8 位，按 [0, 1] 归一化，一个纹素 4 字节
+	RGBA32F // 每个分量一个 float，一个纹素 16 字节；sRGB 图像转换到线性空间后暗部不损失精度
+};
+
+/**
+
+@brief 图像中颜色的编码方式。
+*/
+enum class TextureColorSpace
+{
+	Linear, // 纹素就是线性值，如法线贴图、高度图等数据纹理，加载时不做转换
+	SRGB    // 颜色按 sRGB 编码（常见的颜色贴图），加载时把 RGB 转换到线性空间，alpha 不变；mip 金字塔也在线性空间中生成
+};
+
+/**
+
+@brief 采样器状态。不属于纹理，而是由绑定纹理的一方（如光栅化器）持有，共享同一张纹理的使用者可以各自选择寻址、过滤方式和 LOD 偏移。
+*/
+struct Sampler
+{
+	TextureWrap wrap_u = TextureWrap::Repeat;
+	TextureWrap wrap_v = TextureWrap::Repeat;
+	TextureFilter filter = TextureFilter::Trilinear;
+	float lod_bias = 0.f; // 加到由导数算出的 LOD 上，正值更模糊，负值更锐利
+};
+
 class Texture {
 private:
-	TGAImage image_data;
-public:
-	int width, height;// 贴图纹理的宽与高
-	//加载图片纹理
-	Texture(const char* filename) {
-		image_data.read_tga_file(filename);
-		image_data.flip_vertically();
+	static constexpr int tile_size = 4; // Tiled 布局中分块的边长（纹素）
+
+	/**
+	 * @brief 按缓存行对齐的 64 字节。Tiled 布局中一个分块是 RGBA8 的一条或 RGBA32F 的四条缓存行。
+	 */
+	struct alignas(64) TexelLine
+	{
+		uint8_t bytes[64];
+	};
+
+	/**
+	 * @brief mip 金字塔的一级，纹素按 format 和 layout 存储。
+	 */
+	struct MipLevel
+	{
+		int width, height;
+		int tiles_x; // Tiled 布局中每行的分块数，宽度不是分块边长的倍数时最后一个分块只用了一部分
+		std::vector<TexelLine> lines;
+
+		const uint8_t* texels() const { return lines.empty() ? nullptr : lines[0].bytes; }
+		uint8_t* texels() { return lines.empty() ? nullptr : lines[0].bytes; }
+	};
+
+	std::vector<MipLevel> mips; // mips[0] 是原图，之后每一级的宽高减半，最后一级是 1x1
+	TextureLayout layout = TextureLayout::Linear; // 单线程基准中 Tiled 没有更快，默认按行排列，需要时用 set_layout 切换
+	TexelFormat format = TexelFormat::RGBA8;
+	TextureColorSpace color_space = TextureColorSpace::Linear; // 源图像的颜色编码，纹素本身总是线性值
 
-		width = image_data.get_width();
-		height = image_data.get_height();
+	/**
+	 * @brief 一个纹素占用的字节数。
+	 */
+	static size_t texel_bytes(TexelFormat format) { return format == TexelFormat::RGBA32F ? 16 : 4; }
+
+	/**
+	 * @brief 寻址：纹素 (x, y) 在按 layout 排列的一级中是第几个纹素。两种布局的编号都能拆成只与 y 有关的行偏移加上只与 x 有关的列偏移，
+	 * 双线性采样的 4 个纹素只需要算 2 个行偏移和 2 个列偏移。
+	 */
+	static size_t row_offset(const MipLevel& level, TextureLayout layout, int y)
+	{
+		const unsigned uy = static_cast<unsigned>(y);
+		if (layout == TextureLayout::Linear) return static_cast<size_t>(uy) * level.width;
+		return static_cast<size_t>(uy / tile_size) * level.tiles_x * (tile_size * tile_size) + (uy % tile_size) * tile_size;
+	}
+
+	static size_t column_offset(TextureLayout layout, int x)
+	{
+		const unsigned ux = static_cast<unsigned>(x);
+		if (layout == TextureLayout::Linear) return ux;
+		return (ux / tile_size) * (tile_size * tile_size) + ux % tile_size;
 	}
-	//获取贴图纹理的uv坐标上的颜色
-	TGAColor getColor(float u, float v) {
-		return image_data.get(u, v);
+
+	static size_t texel_index(const MipLevel& level, TextureLayout layout, int x, int y)
+	{
+		return row_offset(level, layout, y) + column_offset(layout, x);
 	}
-};
\ No newline at end of file
+
+	/**
+	 * @brief 把一级按行排列、每个纹素 bytes 字节的数据按指定的布局存储。
+	 */
+	static MipLevel store_level(int width, int height, const uint8_t* rows, size_t bytes, TextureLayout layout);
+
+	/**
+	 * @brief 把按指定布局存储的一级纹素按行取出。
+	 */
+	static std::vector<uint8_t> load_level(const MipLevel& level, size_t bytes, TextureLayout layout);
+
+	/**
+	 * @brief 读取一级中的一个纹素，index 是 texel_index 的结果。
+	 */
+	Vec4f fetch_texel(const MipLevel& level, size_t index) const;
+
+	/**
+	 * @brief 在一级中按寻址方式做最近点或双线性采样。
+	 */
+	Vec4f sample_level(int level, const Vec2f& uv, bool bilinear, const Sampler& sampler) const;
+
+	/**
+	 * @brief 把按行排列的 RGBA8 原图按颜色空间转换成 format，并生成 mip 金字塔。
+	 */
+	void convert(int width, int height, const uint8_t* rgba);
+
+	/**
+	 * @brief 由按行排列的原图逐级 2x2 平均生成 mip 金字塔，T 是 format 的分量类型。
+	 */
+	template <typename T>
+	void build_mips(int width, int height, std::vector<T> rows);
+
+public:
+	int width, height;// 贴图纹理的宽与高
+
+	/**
+	 * @brief 加载图片纹理，转换成指定的纹素格式，并生成 mip 金字塔。
+	 * @param filename TGA 文件路径，加载失败时纹理为空，采样得到 0。
+	 * @param format 纹素格式。
+	 * @param color_space 图片中颜色的编码方式，sRGB 颜色贴图在加载时一次性转换到线性空间，采样时不再转换。
+	 */
+	Texture(const char* filename, TexelFormat format = TexelFormat::RGBA8, TextureColorSpace color_space = TextureColorSpace::Linear);
+
+	/**
+	 * @brief 由内存中的图像创建纹理，并生成 mip 金字塔。
+	 * @param width 宽度。
+	 * @param height 高度。
+	 * @param rgba 按行排列、原点在左下角的 RGBA8 纹素，共 width * height * 4 字节。
+	 * @param format 纹素格式。
+	 * @param color_space rgba 中颜色的编码方式。
+	 */
+	Texture(int width, int height, const uint8_t* rgba, TexelFormat format = TexelFormat::RGBA8,
+		TextureColorSpace color_space = TextureColorSpace::Linear);
+
+	/**
+	 * @brief 纹理只能移动，不能拷贝，需要在多处使用同一张纹理时共享 AssetRegistry 交出的 TextureHandle。
+	 */
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+	Texture(Texture&&) = default;
+	Texture& operator=(Texture&&) = default;
+
+	/**
+	 * @brief mip 金字塔的级数，加载失败时为 0。
+	 */
+	int mip_count() const { return static_cast<int>(mips.size()); }
+
+	TextureLayout get_layout() const { return layout; }
+
+	TexelFormat get_format() const { return format; }
+
+	TextureColorSpace get_color_space() const { return color_space; }
+
+	/**
+	 * @brief 把所有 mip 级别转换成指定的内存布局，默认是 Linear。采样结果与布局无关。
+	 */
+	void set_layout(TextureLayout new_layout);
+
+	/**
+	 * @brief 根据纹理坐标在屏幕空间中的导数计算 LOD：一个像素覆盖的纹素跨度取两个方向中较大的，取以 2 为底的对数，再加上 lod_bias。
+	 * @param duv_dx 屏幕 x 方向移动一个像素时纹理坐标的变化。
+	 * @param duv_dy 屏幕 y 方向移动一个像素时纹理坐标的变化。
+	 * @param sampler 采样器状态，只用到 lod_bias。
+	 * @return LOD，0 是原图，可能为负（放大）或超过最后一级，采样时会截断。
+	 */
+	float compute_lod(const Vec2f& duv_dx, const Vec2f& duv_dy, const Sampler& sampler = Sampler()) const;
+
+	/**
+	 * @brief 按 sampler 在指定的 LOD 上采样。
+	 * @param uv 纹理坐标，原点在左下角。
+	 * @param lod mip 级别，可以是小数，三线性过滤时在相邻两级之间插值。
+	 * @param sampler 采样器状态。
+	 * @return RGBA，各分量在 [0, 1] 内。
+	 */
+	Vec4f sample(const Vec2f& uv, float lod, const Sampler& sampler = Sampler()) const;
+
+	/**
+	 * @brief 按 sampler 采样，LOD 由纹理坐标的屏幕空间导数决定，缩小时读取较小的 mip 级别，访存集中，也没有闪烁。
+	 * @param uv 纹理坐标。
+	 * @param duv_dx 屏幕 x 方向的导数，见 fragment_shader_payload::tex_coords_dx。
+	 * @param duv_dy 屏幕 y 方向的导数。
+	 * @param sampler 采样器状态，见 fragment_shader_payload::sampler。
+	 * @return RGBA，各分量在 [0, 1] 内。
+	 */
+	Vec4f sample(const Vec2f& uv, const Vec2f& duv_dx, const Vec2f& duv_dy, const Sampler& sampler = Sampler()) const;
+
+	/**
+	 * @brief 读取原图中离 (u, v) 最近的纹素，按 sampler 的寻址方式处理越界的坐标，不做过滤。
+	 * @return RGBA，各分量在 [0, 1] 内，sRGB 纹理已经是线性值。
+	 */
+	Vec4f fetch(float u, float v, const Sampler& sampler = Sampler()) const;
+
+	//获取贴图纹理的uv坐标上的颜色：与 fetch 读取同一个纹素，按 RGBA8 返回
+	TGAColor getColor(float u, float v, const Sampler& sampler = Sampler()) const;
+};
+
+/**
+
+@brief 纹素读取的性能测试结果。
+*/
+struct TextureBenchmark
+{
+	long long samples = 0; // 采样次数
+	double seconds = 0; // 总耗时
+	double checksum = 0; // 采样结果之和，防止编译器省去采样，也可以用来确认不同布局的结果相同
+
+	double samples_per_second() const { return seconds > 0 ? samples / seconds : 0; }
+};
+
+/**
+
+@brief 测量在 LOD 0 上连续采样的吞吐量。模拟光栅化的访问顺序：按 8x8 像素块遍历一个与纹理一样大、旋转了 angle 的正方形，
+每个像素按 sampler 采样一次，纹素与像素大约一一对应。旋转使屏幕上的一行在纹理中斜着穿过多行，能体现布局对缓存的影响。
+@param texture 要测试的纹理。
+@param sample_count 采样次数，遍历完一遍正方形后从头再来。
+@param angle 旋转角（弧度）。
+@param sampler 采样器状态。
+*/
+TextureBenchmark benchmark_texture_fetch(const Texture& texture, long long sample_count = 1 << 22, float angle = 0.5f,
+	const Sampler& sampler = Sampler());
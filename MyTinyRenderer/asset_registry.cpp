@@ -0,0 +1,102 @@
+#include <chrono>
+
+#include "asset_registry.h"
+
+template <typename Key, typename Handle, typename Load>
+Handle AssetRegistry::acquire(std::map<Key, std::shared_future<Handle>>& cache, const Key& key, Load load) {
+	std::promise<Handle> promise;
+	std::shared_future<Handle> result;
+	bool loading = false;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		auto it = cache.find(key);
+		if (it != cache.end()) {
+			result = it->second;
+		}
+		else {
+			result = promise.get_future().share();
+			cache.emplace(key, result);
+			loading = true;
+		}
+	}
+	// 资源已经登记（可能还在由其他线程加载），等待结果即可
+	if (!loading) return result.get();
+
+	Handle handle;
+	try {
+		handle = load();
+	}
+	catch (...) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			cache.erase(key);
+		}
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+	if (!handle) {
+		std::lock_guard<std::mutex> lock(mtx);
+		cache.erase(key);
+	}
+	promise.set_value(handle);
+	return handle;
+}
+
+template <typename Key, typename Handle>
+size_t AssetRegistry::release_unused(std::map<Key, std::shared_future<Handle>>& cache) {
+	size_t released = 0;
+	for (auto it = cache.begin(); it != cache.end();) {
+		// 正在加载的资源不能删除，否则其他线程会重复加载；use_count 为 1 说明只有注册表中的这一份
+		const bool ready = it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		if (ready && it->second.get().use_count() == 1) {
+			it = cache.erase(it);
+			released++;
+		}
+		else {
+			++it;
+		}
+	}
+	return released;
+}
+
+TextureHandle AssetRegistry::texture(const std::string& path, TexelFormat format, TextureColorSpace color_space) {
+	return acquire(textures, TextureKey(path, format, color_space), [&]() {
+		auto texture = std::make_shared<const Texture>(path.c_str(), format, color_space);
+		return texture->mip_count() > 0 ? texture : nullptr;
+	});
+}
+
+TextureHandle AssetRegistry::add_texture(const std::string& name, Texture&& texture) {
+	if (texture.mip_count() == 0) return nullptr;
+	const TextureKey key(name, texture.get_format(), texture.get_color_space());
+	return acquire(textures, key, [&]() {
+		return std::make_shared<const Texture>(std::move(texture));
+	});
+}
+
+ModelHandle AssetRegistry::model(const std::string& path) {
+	return acquire(models, path, [&]() {
+		auto model = std::make_shared<Model>(path.c_str());
+		if (model->mesh.triangle_count() == 0) return ModelHandle();
+		// 派生数据只在这里生成一次，之后只交出只读句柄
+		model->build_lods();
+		model->build_meshlets();
+		model->build_bvh();
+		return ModelHandle(std::move(model));
+	});
+}
+
+size_t AssetRegistry::release_unused() {
+	std::lock_guard<std::mutex> lock(mtx);
+	return release_unused(textures) + release_unused(models);
+}
+
+size_t AssetRegistry::texture_count() const {
+	std::lock_guard<std::mutex> lock(mtx);
+	return textures.size();
+}
+
+size_t AssetRegistry::model_count() const {
+	std::lock_guard<std::mutex> lock(mtx);
+	return models.size();
+}
@@ -0,0 +1,101 @@
+/**
+
+@file asset_registry.h
+@brief 资源注册表：按路径缓存已经加载的纹理和模型，每个文件只加载一次，之后只交出共享句柄。
+
+句柄是 std::shared_ptr，复制句柄只增加引用计数，多个光栅化器、多个线程可以同时绑定同一张纹理而不拷贝纹素。
+多个线程同时请求同一个还没加载的资源时，只有第一个线程加载，其余线程等待它的结果；不同资源的加载互不阻塞。
+*/
+#pragma once
+
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "Texture.h"
+#include "model.h"
+
+/**
+
+@brief 纹理的共享句柄。纹理是只读的，采样是 const 操作，多个线程可以同时采样。采样器状态不在纹理中，由绑定句柄的一方各自指定。
+*/
+using TextureHandle = std::shared_ptr<const Texture>;
+
+/**
+
+@brief 模型的共享句柄。模型是只读的，LOD、meshlet 和 BVH 等派生数据在注册表加载时就已生成，多个使用者不会重复生成或同时修改。
+*/
+using ModelHandle = std::shared_ptr<const Model>;
+
+class AssetRegistry
+{
+private:
+	using TextureKey = std::tuple<std::string, TexelFormat, TextureColorSpace>; // 同一个文件按不同格式加载是不同的纹理
+
+	mutable std::mutex mtx; // 保护下面两张表，加载本身在锁外进行
+	std::map<TextureKey, std::shared_future<TextureHandle>> textures;
+	std::map<std::string, std::shared_future<ModelHandle>> models;
+
+	/**
+	 * @brief 在 cache 中查找 key，没有时由当前线程调用 load 加载并登记。加载失败（load 返回空句柄或抛出异常）时不登记，下次请求会重新加载。
+	 */
+	template <typename Key, typename Handle, typename Load>
+	Handle acquire(std::map<Key, std::shared_future<Handle>>& cache, const Key& key, Load load);
+
+	/**
+	 * @brief 删除 cache 中已经加载完成、除注册表外没有其他持有者的资源。
+	 */
+	template <typename Key, typename Handle>
+	static size_t release_unused(std::map<Key, std::shared_future<Handle>>& cache);
+
+public:
+	AssetRegistry() = default;
+
+	AssetRegistry(const AssetRegistry&) = delete;
+	AssetRegistry& operator=(const AssetRegistry&) = delete;
+
+	/**
+	 * @brief 取得纹理，第一次请求时从文件加载。
+	 * @param path TGA 文件路径，按字符串区分，同一个文件的不同写法会被加载两次。
+	 * @param format 纹素格式。
+	 * @param color_space 图片中颜色的编码方式。
+	 * @return 纹理句柄，加载失败时为空。
+	 */
+	TextureHandle texture(const std::string& path, TexelFormat format = TexelFormat::RGBA8,
+		TextureColorSpace color_space = TextureColorSpace::Linear);
+
+	/**
+	 * @brief 登记一张在内存中生成的纹理，纹素被移动进注册表，不会拷贝。已经有同名、同格式的纹理时返回已有的纹理，texture 被丢弃。
+	 * @param name 名字，之后可以用 texture(name, format, color_space) 按纹理自身的格式和颜色空间取回。
+	 * @param texture 纹理。
+	 * @return 纹理句柄，texture 为空时为空。
+	 */
+	TextureHandle add_texture(const std::string& name, Texture&& texture);
+
+	/**
+	 * @brief 取得模型，第一次请求时从 OBJ 文件（或它的网格缓存）加载，并生成 LOD 链、每一级的 meshlet 和 BVH。
+	 * 生成在加载线程中完成，其他线程同时请求时等待同一个结果。
+	 * @param path OBJ 文件路径。
+	 * @return 模型句柄，加载失败或模型没有三角形时为空。
+	 */
+	ModelHandle model(const std::string& path);
+
+	/**
+	 * @brief 释放注册表之外已经没有持有者的纹理和模型。仍在使用的资源不受影响，被释放的资源下次请求时重新加载。
+	 * @return 释放的资源数。
+	 */
+	size_t release_unused();
+
+	/**
+	 * @brief 已登记的纹理数，包括正在加载的。
+	 */
+	size_t texture_count() const;
+
+	/**
+	 * @brief 已登记的模型数，包括正在加载的。
+	 */
+	size_t model_count() const;
+};
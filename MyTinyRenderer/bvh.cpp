@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bvh.h"
+#include "simd_target.h"
+#include "thread_pool.h"
+
+namespace {
+
+	constexpr int bin_count = 16; // SAH 每个轴上的分箱数
+	constexpr float traversal_cost = 1.f; // 访问一个内部节点的代价，以一次三角形相交测试为单位
+	constexpr int median_depth = 24; // 更深的节点改用中位数划分，每层三角形数减半，保证总层数不超过 Bvh::max_depth
+	constexpr int parallel_min_triangles = 16384; // 三角形数少于这个值时串行构建
+
+	static float axis_value(const Vec3f& v, int axis) {
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	struct Aabb {
+		Vec3f lo = Vec3f(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity());
+		Vec3f hi = Vec3f(-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());
+
+		void grow(const Vec3f& p) {
+			lo = Vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+			hi = Vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+		}
+
+		void grow(const Aabb& box) {
+			grow(box.lo);
+			grow(box.hi);
+		}
+
+		// 表面积，空包围盒为 0
+		float area() const {
+			const Vec3f d = hi - lo;
+			if (!(d.x >= 0)) return 0;
+			return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+	};
+
+	struct BuildPrim {
+		Aabb box;
+		Vec3f centroid;
+	};
+
+	// 留给线程池构建的子树，根节点已经在节点数组中占好位置
+	struct Subtree {
+		uint32_t node;
+		uint32_t begin;
+		uint32_t end;
+		int depth;
+	};
+
+	/**
+	 * @brief 自顶向下的分箱 SAH 构建。不同的子树只读写 order 中互不重叠的区间，可以在多个线程中同时构建。
+	 */
+	class BvhBuilder {
+	private:
+		const std::vector<BuildPrim>& prims;
+		std::vector<uint32_t>& order;
+
+		// 在 centroid_box 最长的轴上按质心的中位数划分
+		uint32_t split_median(uint32_t begin, uint32_t end, const Aabb& centroid_box) {
+			const Vec3f extent = centroid_box.hi - centroid_box.lo;
+			const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+			const uint32_t mid = begin + (end - begin) / 2;
+			std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t a, uint32_t b) {
+				return axis_value(prims[a].centroid, axis) < axis_value(prims[b].centroid, axis);
+			});
+			return mid;
+		}
+
+		/**
+		 * @brief 在三个轴上各把质心范围等分成 bin_count 个箱，求 SAH 代价最小的划分。
+		 * @return 划分后右半部分的起点；不值得划分（代价不低于叶节点）时返回 end。
+		 */
+		uint32_t split_sah(uint32_t begin, uint32_t end, const Aabb& box, const Aabb& centroid_box) {
+			const uint32_t count = end - begin;
+			float best_cost = static_cast<float>(count); // 叶节点的代价
+			int best_axis = -1;
+			int best_bin = 0;
+			for (int axis = 0; axis < 3; axis++) {
+				const float lo = axis_value(centroid_box.lo, axis);
+				const float extent = axis_value(centroid_box.hi, axis) - lo;
+				if (!(extent > 0)) continue;
+				const float scale = bin_count / extent;
+
+				Aabb bins[bin_count];
+				uint32_t counts[bin_count] = {};
+				for (uint32_t i = begin; i < end; i++) {
+					const BuildPrim& prim = prims[order[i]];
+					const int b = std::min(bin_count - 1, static_cast<int>((axis_value(prim.centroid, axis) - lo) * scale));
+					bins[b].grow(prim.box);
+					counts[b]++;
+				}
+
+				// 从右往左累计右半部分的面积和数量，再从左往右扫描
+				float right_area[bin_count];
+				uint32_t right_count[bin_count];
+				Aabb right;
+				uint32_t n = 0;
+				for (int b = bin_count - 1; b > 0; b--) {
+					right.grow(bins[b]);
+					n += counts[b];
+					right_area[b] = right.area();
+					right_count[b] = n;
+				}
+				Aabb left;
+				n = 0;
+				for (int b = 1; b < bin_count; b++) {
+					left.grow(bins[b - 1]);
+					n += counts[b - 1];
+					if (n == 0 || right_count[b] == 0) continue;
+					const float cost = traversal_cost + (left.area() * n + right_area[b] * right_count[b]) / box.area();
+					if (cost < best_cost) {
+						best_cost = cost;
+						best_axis = axis;
+						best_bin = b;
+					}
+				}
+			}
+			if (best_axis < 0) return end;
+
+			const float lo = axis_value(centroid_box.lo, best_axis);
+			const float scale = bin_count / (axis_value(centroid_box.hi, best_axis) - lo);
+			auto middle = std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t t) {
+				return std::min(bin_count - 1, static_cast<int>((axis_value(prims[t].centroid, best_axis) - lo) * scale)) < best_bin;
+			});
+			return static_cast<uint32_t>(middle - order.begin());
+		}
+
+	public:
+		BvhBuilder(const std::vector<BuildPrim>& prims, std::vector<uint32_t>& order) : prims(prims), order(order) {}
+
+		/**
+		 * @brief 在 nodes[index] 处构建 order[begin, end) 的子树。
+		 * @param depth nodes[index] 在整棵树中的深度，根节点是 0。
+		 * @param deferred 不为 nullptr 时，三角形数不超过 defer_size 的子树只记录在这里，由调用者另外构建。
+		 * @return 子树的层数，留待以后构建的子树算作一层。
+		 */
+		int build(std::vector<BvhNode>& nodes, uint32_t index, uint32_t begin, uint32_t end, int depth,
+			std::vector<Subtree>* deferred, uint32_t defer_size) {
+			Aabb box, centroid_box;
+			for (uint32_t i = begin; i < end; i++) {
+				box.grow(prims[order[i]].box);
+				centroid_box.grow(prims[order[i]].centroid);
+			}
+			BvhNode& node = nodes[index];
+			node.bounds_min[0] = box.lo.x;
+			node.bounds_min[1] = box.lo.y;
+			node.bounds_min[2] = box.lo.z;
+			node.bounds_max[0] = box.hi.x;
+			node.bounds_max[1] = box.hi.y;
+			node.bounds_max[2] = box.hi.z;
+			node.first = begin;
+			node.count = end - begin;
+
+			const uint32_t count = end - begin;
+			if (deferred && count <= defer_size) {
+				deferred->push_back({ index, begin, end, depth });
+				return 1;
+			}
+			if (count <= 1) return 1;
+
+			uint32_t mid = end;
+			if (depth < median_depth) mid = split_sah(begin, end, box, centroid_box);
+			if (mid == end || mid == begin) {
+				// SAH 认为不值得划分，或者所有质心重合，三角形不多时就做成叶节点
+				if (count <= static_cast<uint32_t>(Bvh::max_leaf_size)) return 1;
+				mid = split_median(begin, end, centroid_box);
+			}
+
+			const uint32_t left = static_cast<uint32_t>(nodes.size());
+			nodes.resize(left + 2);
+			nodes[index].first = left; // resize 之后 node 可能已经失效
+			nodes[index].count = 0;
+			const int left_levels = build(nodes, left, begin, mid, depth + 1, deferred, defer_size);
+			const int right_levels = build(nodes, left + 1, mid, end, depth + 1, deferred, defer_size);
+			return 1 + std::max(left_levels, right_levels);
+		}
+	};
+
+	/**
+	 * @brief 遍历时每条射线只算一次的数据。方向分量为 0 时倒数取一个很大的有限值，避免 0 * inf 得到 NaN。
+	 */
+	struct RayData {
+#ifdef RST_X86
+		__m128 origin;
+		__m128 inv_dir;
+#else
+		float origin[3];
+		float inv_dir[3];
+#endif
+	};
+
+	static float safe_inverse(float d) {
+		return std::abs(d) > 1e-20f ? 1.f / d : std::copysign(1e20f, d);
+	}
+
+	static RayData make_ray_data(const Ray& ray) {
+		RayData r;
+#ifdef RST_X86
+		// 第 4 个分量都是 0，和包围盒被屏蔽的第 4 个分量运算后仍然是 0
+		r.origin = _mm_set_ps(0.f, ray.origin.z, ray.origin.y, ray.origin.x);
+		r.inv_dir = _mm_set_ps(0.f, safe_inverse(ray.direction.z), safe_inverse(ray.direction.y), safe_inverse(ray.direction.x));
+#else
+		r.origin[0] = ray.origin.x;
+		r.origin[1] = ray.origin.y;
+		r.origin[2] = ray.origin.z;
+		r.inv_dir[0] = safe_inverse(ray.direction.x);
+		r.inv_dir[1] = safe_inverse(ray.direction.y);
+		r.inv_dir[2] = safe_inverse(ray.direction.z);
+#endif
+		return r;
+	}
+
+	/**
+	 * @brief 射线与节点包围盒的 slab 测试，x86 上三个轴在一个 SSE 寄存器中同时计算。
+	 * @param t_entry 输出射线进入包围盒时的参数，用于决定先访问哪个子节点。
+	 */
+	static inline bool hit_box(const BvhNode& node, const RayData& r, float t_min, float t_max, float& t_entry) {
+#ifdef RST_X86
+		// 节点的第 4 个分量是 first 和 count，载入后清零
+		const __m128 xyz_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const __m128 lo = _mm_and_ps(_mm_loadu_ps(node.bounds_min), xyz_mask);
+		const __m128 hi = _mm_and_ps(_mm_loadu_ps(node.bounds_max), xyz_mask);
+		const __m128 t0 = _mm_mul_ps(_mm_sub_ps(lo, r.origin), r.inv_dir);
+		const __m128 t1 = _mm_mul_ps(_mm_sub_ps(hi, r.origin), r.inv_dir);
+		// 第 4 个分量换成射线的区间，参与下面的水平最大值和最小值
+		__m128 near_t = _mm_or_ps(_mm_and_ps(_mm_min_ps(t0, t1), xyz_mask), _mm_set_ps(t_min, 0.f, 0.f, 0.f));
+		__m128 far_t = _mm_or_ps(_mm_and_ps(_mm_max_ps(t0, t1), xyz_mask), _mm_set_ps(t_max, 0.f, 0.f, 0.f));
+		near_t = _mm_max_ps(near_t, _mm_shuffle_ps(near_t, near_t, _MM_SHUFFLE(1, 0, 3, 2)));
+		near_t = _mm_max_ps(near_t, _mm_shuffle_ps(near_t, near_t, _MM_SHUFFLE(2, 3, 0, 1)));
+		far_t = _mm_min_ps(far_t, _mm_shuffle_ps(far_t, far_t, _MM_SHUFFLE(1, 0, 3, 2)));
+		far_t = _mm_min_ps(far_t, _mm_shuffle_ps(far_t, far_t, _MM_SHUFFLE(2, 3, 0, 1)));
+		t_entry = _mm_cvtss_f32(near_t);
+		return t_entry <= _mm_cvtss_f32(far_t);
+#else
+		float enter = t_min, exit = t_max;
+		for (int k = 0; k < 3; k++) {
+			const float t0 = (node.bounds_min[k] - r.origin[k]) * r.inv_dir[k];
+			const float t1 = (node.bounds_max[k] - r.origin[k]) * r.inv_dir[k];
+			enter = std::max(enter, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+		t_entry = enter;
+		return enter <= exit;
+#endif
+	}
+
+} // namespace
+
+Bvh::Bvh(const Mesh& mesh, int thread_count) {
+	const int triangle_count = mesh.triangle_count();
+	if (triangle_count == 0) return;
+
+	std::vector<BuildPrim> prims(triangle_count);
+	for (int t = 0; t < triangle_count; t++) {
+		for (int k = 0; k < 3; k++) prims[t].box.grow(mesh.positions[mesh.indices[3 * t + k]]);
+		prims[t].centroid = (prims[t].box.lo + prims[t].box.hi) * 0.5f;
+	}
+	std::vector<uint32_t> order(triangle_count);
+	std::iota(order.begin(), order.end(), 0u);
+
+	if (thread_count <= 0) thread_count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	BvhBuilder builder(prims, order);
+	nodes.reserve(2 * static_cast<size_t>(triangle_count));
+	nodes.resize(1);
+
+	// 三角形足够多时，上层串行划分到每棵子树不超过总数的 1 / (4 * 线程数)，再由线程池并行构建这些子树
+	std::vector<Subtree> deferred;
+	const bool parallel = thread_count > 1 && triangle_count >= parallel_min_triangles;
+	depth = builder.build(nodes, 0, 0, triangle_count, 0, parallel ? &deferred : nullptr, triangle_count / (4u * thread_count));
+
+	if (!deferred.empty()) {
+		std::vector<std::vector<BvhNode>> subtrees(deferred.size());
+		std::vector<int> levels(deferred.size());
+		ThreadPool pool(thread_count);
+		pool.parallel_for(static_cast<int>(deferred.size()), [&](int i) {
+			const Subtree& s = deferred[i];
+			subtrees[i].reserve(2 * static_cast<size_t>(s.end - s.begin));
+			subtrees[i].resize(1);
+			levels[i] = builder.build(subtrees[i], 0, s.begin, s.end, s.depth, nullptr, 0);
+		});
+		// 子树的根节点放回占好的位置，其余节点依次追加到末尾，子节点编号相应平移
+		for (size_t i = 0; i < deferred.size(); i++) {
+			const uint32_t base = static_cast<uint32_t>(nodes.size()) - 1;
+			for (size_t j = 0; j < subtrees[i].size(); j++) {
+				BvhNode node = subtrees[i][j];
+				if (node.count == 0) node.first += base;
+				if (j == 0) nodes[deferred[i].node] = node;
+				else nodes.push_back(node);
+			}
+			depth = std::max(depth, deferred[i].depth + levels[i]);
+		}
+	}
+
+	triangles.resize(triangle_count);
+	for (int i = 0; i < triangle_count; i++) {
+		const uint32_t t = order[i];
+		const Vec3f& v0 = mesh.positions[mesh.indices[3 * t]];
+		triangles[i].v0 = v0;
+		triangles[i].e1 = mesh.positions[mesh.indices[3 * t + 1]] - v0;
+		triangles[i].e2 = mesh.positions[mesh.indices[3 * t + 2]] - v0;
+		triangles[i].index = t;
+	}
+}
+
+template <bool AnyHit>
+bool Bvh::traverse(const Ray& ray, RayHit& hit) const {
+	if (nodes.empty()) return false;
+	const RayData r = make_ray_data(ray);
+	float closest = ray.t_max;
+	bool found = false;
+
+	// 栈中保存待访问的节点和射线进入它的参数，出栈时已经有更近的交点就跳过
+	struct Entry {
+		uint32_t node;
+		float t;
+	};
+	Entry stack[max_depth];
+	int top = 0;
+
+	float t_root;
+	if (!hit_box(nodes[0], r, ray.t_min, closest, t_root)) return false;
+	uint32_t current = 0;
+	for (;;) {
+		const BvhNode& node = nodes[current];
+		if (node.count == 0) {
+			float t_left, t_right;
+			const bool left = hit_box(nodes[node.first], r, ray.t_min, closest, t_left);
+			const bool right = hit_box(nodes[node.first + 1], r, ray.t_min, closest, t_right);
+			if (left && right) {
+				const bool left_first = t_left <= t_right;
+				current = left_first ? node.first : node.first + 1;
+				stack[top++] = { left_first ? node.first + 1 : node.first, left_first ? t_right : t_left };
+				continue;
+			}
+			if (left || right) {
+				current = left ? node.first : node.first + 1;
+				continue;
+			}
+		}
+		else {
+			// Möller–Trumbore，三角形两面都相交
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const LeafTriangle& tri = triangles[i];
+				const Vec3f p = ray.direction ^ tri.e2;
+				const float det = tri.e1 * p;
+				if (det == 0.f) continue;
+				const float inv_det = 1.f / det;
+				const Vec3f s = ray.origin - tri.v0;
+				const float u = (s * p) * inv_det;
+				if (u < 0.f || u > 1.f) continue;
+				const Vec3f q = s ^ tri.e1;
+				const float v = (ray.direction * q) * inv_det;
+				if (v < 0.f || u + v > 1.f) continue;
+				const float t = (tri.e2 * q) * inv_det;
+				if (!(t > ray.t_min && t < closest)) continue;
+				if (AnyHit) return true;
+				closest = t;
+				hit.t = t;
+				hit.u = u;
+				hit.v = v;
+				hit.triangle = static_cast<int>(tri.index);
+				found = true;
+			}
+		}
+
+		// 出栈，跳过比当前最近交点还远的节点
+		for (;;) {
+			if (top == 0) return found;
+			const Entry& e = stack[--top];
+			if (e.t <= closest) {
+				current = e.node;
+				break;
+			}
+		}
+	}
+}
+
+bool Bvh::intersect(const Ray& ray, RayHit& hit) const {
+	return traverse<false>(ray, hit);
+}
+
+bool Bvh::occluded(const Ray& ray) const {
+	RayHit unused;
+	return traverse<true>(ray, unused);
+}
+
+RayBenchmark benchmark_bvh(const Bvh& bvh, const Vec3f& bounds_min, const Vec3f& bounds_max, int ray_count, bool any_hit, int thread_count) {
+	RayBenchmark result;
+	if (bvh.empty() || ray_count <= 0) return result;
+
+	std::mt19937 rng(20240601u);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	const Vec3f center = (bounds_min + bounds_max) * 0.5f;
+	const Vec3f extent = bounds_max - bounds_min;
+	const float radius = extent.norm() * 0.5f;
+	std::vector<Ray> rays(ray_count);
+	for (Ray& ray : rays) {
+		// 起点均匀分布在球面上，终点均匀分布在包围盒内
+		const float z = 2.f * unit(rng) - 1.f;
+		const float phi = 6.2831853f * unit(rng);
+		const float s = std::sqrt(std::max(0.f, 1.f - z * z));
+		ray.origin = center + Vec3f(s * std::cos(phi), s * std::sin(phi), z) * (2.f * radius);
+		const Vec3f target = bounds_min + extent.cwiseProduct(Vec3f(unit(rng), unit(rng), unit(rng)));
+		ray.direction = target - ray.origin;
+	}
+
+	if (thread_count <= 0) thread_count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	constexpr int batch = 4096;
+	const int batch_count = (ray_count + batch - 1) / batch;
+	std::vector<long long> batch_hits(batch_count, 0);
+	auto run = [&](int b) {
+		long long hits = 0;
+		const int end = std::min(ray_count, (b + 1) * batch);
+		for (int i = b * batch; i < end; i++) {
+			RayHit hit;
+			hits += any_hit ? bvh.occluded(rays[i]) : bvh.intersect(rays[i], hit);
+		}
+		batch_hits[b] = hits;
+	};
+
+	std::unique_ptr<ThreadPool> pool;
+	if (thread_count > 1 && batch_count > 1) pool = std::make_unique<ThreadPool>(thread_count);
+	auto start = std::chrono::steady_clock::now();
+	if (pool) pool->parallel_for(batch_count, run);
+	else {
+		for (int b = 0; b < batch_count; b++) run(b);
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.rays = ray_count;
+	for (long long h : batch_hits) result.hits += h;
+	return result;
+}
@@ -0,0 +1,150 @@
+/**
+
+@file bvh.h
+@brief 网格三角形的层次包围盒（BVH），用于射线查询：鼠标拾取、阴影射线等。
+
+用分箱的表面积启发式（SAH）自顶向下构建，上层节点串行划分，划分出足够多的子树后由线程池并行构建。
+节点是 32 字节的轴对齐包围盒，两个子节点相邻存放；射线与包围盒的相交测试在 x86 上用 SSE 一次处理三个轴。
+*/
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "geometry.h"
+#include "mesh.h"
+
+/**
+
+@brief 射线 origin + t * direction，只查询 t_min < t < t_max 的部分。direction 不需要归一化，t 以 direction 的长度为单位。
+*/
+struct Ray
+{
+	Vec3f origin;
+	Vec3f direction;
+	float t_min = 0.f;
+	float t_max = std::numeric_limits<float>::infinity();
+};
+
+/**
+
+@brief 最近交点。
+*/
+struct RayHit
+{
+	float t = std::numeric_limits<float>::infinity(); // 交点的射线参数
+	float u = 0.f; // 交点在三角形中顶点 1 和顶点 2 的重心坐标，顶点 0 的是 1 - u - v
+	float v = 0.f;
+	int triangle = -1; // 三角形在网格中的编号，没有交点时为 -1
+};
+
+/**
+
+@brief BVH 节点，32 字节。
+*/
+struct BvhNode
+{
+	float bounds_min[3];
+	uint32_t first; // 内部节点：左子节点的编号，右子节点是 first + 1；叶节点：第一个三角形在 Bvh 三角形数组中的编号
+	float bounds_max[3];
+	uint32_t count; // 叶节点的三角形数，内部节点为 0
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode must stay 32 bytes");
+
+/**
+
+@brief 网格三角形的 BVH。构建时复制三角形的顶点坐标，之后与网格无关。
+*/
+class Bvh
+{
+private:
+	/**
+	 * @brief 按叶节点顺序存放的三角形，预先算好两条边，供 Möller–Trumbore 相交测试使用。
+	 */
+	struct LeafTriangle
+	{
+		Vec3f v0;
+		Vec3f e1; // v1 - v0
+		Vec3f e2; // v2 - v0
+		uint32_t index; // 三角形在网格中的编号
+	};
+
+	std::vector<BvhNode> nodes; // nodes[0] 是根节点
+	std::vector<LeafTriangle> triangles;
+	int depth = 0; // 树的层数，遍历栈的深度不会超过它
+
+	/**
+	 * @brief intersect 和 occluded 共用的遍历：先进入射线先到达的子节点，另一个压栈。
+	 * @tparam AnyHit 为 true 时找到任意交点就返回，否则找最近交点。
+	 */
+	template <bool AnyHit>
+	bool traverse(const Ray& ray, RayHit& hit) const;
+
+public:
+	static constexpr int max_depth = 64; // 构建保证树的层数不超过这个值
+	static constexpr int max_leaf_size = 8; // 叶节点最多包含的三角形数
+
+	Bvh() = default;
+
+	/**
+	 * @brief 为网格的全部三角形构建 BVH。
+	 * @param mesh 网格，构建完成后可以释放。
+	 * @param thread_count 构建使用的线程数。默认是0，表示使用硬件并发数；为1时串行构建。
+	 */
+	explicit Bvh(const Mesh& mesh, int thread_count = 0);
+
+	bool empty() const { return triangles.empty(); }
+
+	int node_count() const { return static_cast<int>(nodes.size()); }
+
+	int tree_depth() const { return depth; }
+
+	/**
+	 * @brief 节点和三角形占用的字节数。
+	 */
+	size_t memory_bytes() const { return nodes.size() * sizeof(BvhNode) + triangles.size() * sizeof(LeafTriangle); }
+
+	/**
+	 * @brief 最近交点查询。三角形两面都会相交。
+	 * @param ray 射线。
+	 * @param hit 输出的最近交点，没有交点时不修改。
+	 * @return 有交点时返回 true。
+	 */
+	bool intersect(const Ray& ray, RayHit& hit) const;
+
+	/**
+	 * @brief 任意交点查询，找到第一个交点就返回，用于阴影射线这类只关心是否被遮挡的查询。
+	 * @param ray 射线。从表面出发时应把起点沿法向量偏移一点或设置 t_min，避免与出发的三角形自身相交。
+	 * @return 射线在 (t_min, t_max) 内与任意三角形相交时返回 true。
+	 */
+	bool occluded(const Ray& ray) const;
+};
+
+/**
+
+@brief 射线查询的性能测试结果。
+*/
+struct RayBenchmark
+{
+	long long rays = 0; // 发射的射线数
+	long long hits = 0; // 有交点的射线数
+	double seconds = 0; // 查询的总耗时，不包括生成射线
+
+	double rays_per_second() const { return seconds > 0 ? rays / seconds : 0; }
+};
+
+/**
+
+@brief 测量 BVH 每秒能处理多少条射线。射线从包围盒外接球的两倍半径处出发，射向包围盒内的随机点，
+随机数种子固定，同一个 BVH 每次测试的射线相同。
+@param bvh 要测试的 BVH。
+@param bounds_min 网格包围盒的最小角。
+@param bounds_max 网格包围盒的最大角。
+@param ray_count 射线数。
+@param any_hit 为 true 时测试 occluded，否则测试 intersect。
+@param thread_count 查询使用的线程数。默认是0，表示使用硬件并发数。
+*/
+RayBenchmark benchmark_bvh(const Bvh& bvh, const Vec3f& bounds_min, const Vec3f& bounds_max,
+	int ray_count = 1 << 20, bool any_hit = false, int thread_count = 0);
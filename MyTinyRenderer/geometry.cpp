@@ -212,8 +212,8 @@ std::ostream& operator<<(std::ostream& s, Mat3f& m)
 }
 
 Mat3f& Mat3f::operator<<(const Vec3f& v) {
-	// 确保当前行的索引在有效范围内
-	static int currentRow = 0;
+	// 确保当前行的索引在有效范围内（片元着色器会在多个光栅化线程中同时调用，所以每个线程各自计数）
+	static thread_local int currentRow = 0;
 	if (currentRow >= 3) {
 		currentRow = 0; // 重置到第一行
 	}
@@ -361,6 +361,24 @@ Mat4f Mat4f::inverse()
 	return inv;
 }
 
+Mat4f Mat4f::affine_inverse() const
+{
+	//左上角 3x3 用伴随矩阵求逆，平移取反后再变换
+	Vec3f r[3] = { Vec3f(rows[0].x, rows[0].y, rows[0].z), Vec3f(rows[1].x, rows[1].y, rows[1].z), Vec3f(rows[2].x, rows[2].y, rows[2].z) };
+	Vec3f c[3] = { r[1] ^ r[2], r[2] ^ r[0], r[0] ^ r[1] };//逆矩阵的三列乘以行列式
+	float det = r[0] * c[0];
+	Mat4f inv = Mat4f::identity();
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			inv[i][j] = c[j][i] / det;
+		}
+	}
+	for (int i = 0; i < 3; i++) {
+		inv[i][3] = -(inv[i][0] * rows[0].w + inv[i][1] * rows[1].w + inv[i][2] * rows[2].w);
+	}
+	return inv;
+}
+
 Mat4f Mat4f::identity()
 {
 	// 静态方法，返回一个 4x4 的单位矩阵
@@ -282,6 +282,12 @@ public:
 	 */
 	Mat4f inverse();
 
+	/**
+	 * @brief 计算仿射变换矩阵（最后一行是 0 0 0 1）的逆矩阵，比 inverse 的一般消元快，也更精确
+	 * @return 返回矩阵的逆矩阵，左上角 3x3 不可逆时结果中含有无穷大或 NaN
+	 */
+	Mat4f affine_inverse() const;
+
 	/**
 	 * @brief 静态方法，返回一个 4x4 的单位矩阵
 	 * @return 返回一个 4x4 的单位矩阵
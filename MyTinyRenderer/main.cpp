@@ -1,14 +1,18 @@
 #include <iostream>
+#include <cstring>
+#include <random>
+#include <cstdio>
 #include "geometry.h"
 #include "model.h"
 #include "Shader.h"
 #include "rasterizer.h"
 #include "camera.h"
+#include "asset_registry.h"
 
 const int width = 800;
 const int height = 800;
 
-Model* model = nullptr;
+const Model* model = nullptr; //当前绘制的模型，由 main 中的资源注册表持有
 
 Vec3f eye_position(1.f, 1.f, 3.f);//相机摆放的位置
 Vec3f center(0.f, 0.f, 0.f);//相机中心指向center
@@ -24,6 +28,15 @@ struct light
 	Vec3f intensity;//光源强度
 };
 
+//阴影射线使用的 BVH（在模型空间中），为 nullptr 时不计算阴影；只有命令行给出 --shadows 时才设置
+const Bvh* shadow_bvh = nullptr;
+//把视图空间的坐标变换回模型空间，即 MV 矩阵的逆矩阵
+Mat4f view_to_model = Mat4f::identity();
+//阴影射线起点沿法向量偏移的最小距离（视图空间），避免与所在的三角形自身相交
+const float base_shadow_bias = 1e-3f;
+//实际使用的偏移距离：BVH 由原始网格构建，绘制较粗的 LOD 时还要加上该 LOD 相对原始网格的误差，否则粗网格的表面会被细网格挡住
+float shadow_bias = base_shadow_bias;
+
 //模型变换矩阵
 Mat4f modelMatrix()
 {
@@ -101,6 +114,25 @@ Vec3f G_fragment_shader(const fragment_shader_payload& payload) {
 	return color_frag;
 }
 
+//视图空间中的点到光源之间是否被模型挡住
+bool in_shadow(const Vec3f& point, const Vec3f& normal, const Vec3f& light_position)
+{
+	auto to_model = [](const Vec3f& p) {
+		Vec4f q(p.x, p.y, p.z, 1.f);
+		Vec4f r = view_to_model * q;
+		return Vec3f(r.x, r.y, r.z);
+	};
+	//起点朝光源一侧偏移，射线只查询起点到光源之间的线段（t < 1）
+	Vec3f n = normal;
+	n.normalize();
+	Vec3f offset = n * ((light_position - point) * n >= 0 ? shadow_bias : -shadow_bias);
+	Ray ray;
+	ray.origin = to_model(point + offset);
+	ray.direction = to_model(light_position) - ray.origin;
+	ray.t_max = 1.f;
+	return shadow_bvh->occluded(ray);
+}
+
 //Phong着色
 Vec3f phong_fragment_shader(const fragment_shader_payload& payload) {
 
@@ -139,6 +171,9 @@ Vec3f phong_fragment_shader(const fragment_shader_payload& payload) {
 
 	for (auto& light : lights)
 	{
+		//阴影：被模型挡住的光源没有漫反射和镜面反射
+		if (shadow_bvh && in_shadow(point, normal, light.position)) continue;
+
 		Vec3f light_dir = light.position - point;//光线方向
 		float r2 = light_dir.norm() * light_dir.norm();//光线方向的模长的平方
 		light_dir.normalize();//光线方向归一化
@@ -163,16 +198,12 @@ Vec3f texture_fragment_shader(const fragment_shader_payload& payload) {
 	Vec3f return_color = { 0, 0, 0 };
 	if (payload.texture)
 	{
-		// 从纹理中获取颜色
-		return_color = Vec3f(payload.texture->getColor(payload.tex_coords.x, payload.tex_coords.y).bgra[2] / 255.0f,
-			payload.texture->getColor(payload.tex_coords.x, payload.tex_coords.y).bgra[1] / 255.0f,
-			payload.texture->getColor(payload.tex_coords.x, payload.tex_coords.y).bgra[0] / 255.0f);
+		// 从纹理中获取颜色，按纹理坐标的屏幕空间导数选择 mip 级别并做三线性过滤
+		Vec4f texel = payload.texture->sample(payload.tex_coords, payload.tex_coords_dx, payload.tex_coords_dy, payload.sampler);
+		return_color = Vec3f(texel.x, texel.y, texel.z);
 	}
-	Vec3f texture_color;
-	texture_color = return_color * 255;
-
 	Vec3f ka = Vec3f(0.005, 0.005, 0.005);//环境光系数
-	Vec3f kd = texture_color / 255.f;//漫反射系数
+	Vec3f kd = return_color;//漫反射系数
 	Vec3f ks = Vec3f(0.7937, 0.7937, 0.7937);//高光(镜面)反射系数
 
 	auto l1 = light{ {20,20,20},{500,500,500} };
@@ -256,8 +287,10 @@ Vec3f bump_fragment_shader(const fragment_shader_payload& payload)
 	TBN << t, b, normal;
 
 	// 计算法线贴图的偏移量以更新法线
-	float dU = kh * kn * (payload.texture->getColor(u + 1.0f / w, v).bgra[2] - payload.texture->getColor(u, v).bgra[2]);
-	float dV = kh * kn * (payload.texture->getColor(u, v + 1.0f / h).bgra[2] - payload.texture->getColor(u, v).bgra[2]);
+	// 高度取红色通道，乘以 255 换算回 8 位的取值范围，中心纹素只读一次
+	float height_uv = payload.texture->fetch(u, v, payload.sampler).x * 255.f;
+	float dU = kh * kn * (payload.texture->fetch(u + 1.0f / w, v, payload.sampler).x * 255.f - height_uv);
+	float dV = kh * kn * (payload.texture->fetch(u, v + 1.0f / h, payload.sampler).x * 255.f - height_uv);
 	Vec3f ln = { -dU, -dV, 1 };
 	normal = (TBN * ln).normalize();
 
@@ -303,10 +336,12 @@ Vec3f displacement_fragment_shader(const fragment_shader_payload& payload)
 	TBN << t, b, normal;
 
 	// 计算法线贴图的偏移量以更新法线
-	float dU = kh * kn * (payload.texture->getColor(u + 1.0f / w, v).bgra[2] - payload.texture->getColor(u, v).bgra[2]);
-	float dV = kh * kn * (payload.texture->getColor(u, v + 1.0f / h).bgra[2] - payload.texture->getColor(u, v).bgra[2]);
+	// 高度取红色通道，乘以 255 换算回 8 位的取值范围，中心纹素只读一次
+	float height_uv = payload.texture->fetch(u, v, payload.sampler).x * 255.f;
+	float dU = kh * kn * (payload.texture->fetch(u + 1.0f / w, v, payload.sampler).x * 255.f - height_uv);
+	float dV = kh * kn * (payload.texture->fetch(u, v + 1.0f / h, payload.sampler).x * 255.f - height_uv);
 	Vec3f ln = { -dU, -dV, 1 };
-	point = point + normal * kn * payload.texture->getColor(u, v).bgra[2];
+	point = point + normal * kn * height_uv;
 	normal = (TBN * ln).normalize();
 
 	Vec3f result_color = { 0, 0, 0 };
@@ -343,15 +378,75 @@ Vec3f displacement_fragment_shader(const fragment_shader_payload& payload)
 
 
 int main(int argc, char** argv) {
-	if (2 == argc) {
-		model = new Model(argv[1]);
+	//命令行参数：[模型路径] [--shadows] [--bench-bvh] [--bench-texture] [--bench-tga]
+	const char* obj_path = "res/objs/african_head.obj";
+	bool shadows = false;
+	bool bench_bvh = false;
+	bool bench_texture = false;
+	bool bench_tga = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--shadows") == 0) shadows = true;
+		else if (std::strcmp(argv[i], "--bench-bvh") == 0) bench_bvh = true;
+		else if (std::strcmp(argv[i], "--bench-texture") == 0) bench_texture = true;
+		else if (std::strcmp(argv[i], "--bench-tga") == 0) bench_tga = true;
+		else obj_path = argv[i];
+	}
+
+	if (bench_tga) {
+		//每种位深分别测试未压缩和 RLE 压缩的 8K 图像的读写吞吐量
+		for (int bytespp : { TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA }) {
+			for (bool rle : { false, true }) {
+				TGABenchmark bench = benchmark_tga(8192, 8192, bytespp, rle, "bench.tga");
+				std::cout << "tga " << bytespp * 8 << "-bit " << (rle ? "rle " : "raw ") << bench.file_bytes << " bytes, write "
+					<< bench.write_megabytes_per_second() << " MB/s, read " << bench.read_megabytes_per_second() << " MB/s"
+					<< (bench.round_trip ? "" : ", round trip FAILED") << std::endl;
+			}
+		}
+		std::remove("bench.tga");
+		return 0;
+	}
+
+	if (bench_texture) {
+		//用随机纹素生成几种尺寸的纹理，比较按行排列和分块排列时双线性采样的吞吐量
+		std::mt19937 rng(1);
+		for (int size : { 256, 1024, 4096 }) {
+			std::vector<uint8_t> rgba(static_cast<size_t>(size) * size * 4);
+			for (uint8_t& c : rgba) c = static_cast<uint8_t>(rng());
+			Texture tex(size, size, rgba.data());
+			Sampler sampler;
+			sampler.filter = TextureFilter::Bilinear;
+			for (TextureLayout layout : { TextureLayout::Linear, TextureLayout::Tiled }) {
+				tex.set_layout(layout);
+				TextureBenchmark bench = benchmark_texture_fetch(tex, 1 << 24, 0.5f, sampler);
+				std::cout << "texture " << size << "x" << size << (layout == TextureLayout::Linear ? " linear " : " tiled ")
+					<< bench.samples << " samples, " << bench.seconds * 1000.0 << " ms, " << bench.samples_per_second() / 1e6
+					<< " Msamples/s, checksum " << bench.checksum << std::endl;
+			}
+		}
+		return 0;
 	}
-	else {
-		model = new Model("res/objs/african_head.obj");
+	//模型和纹理都从资源注册表取得，同一个文件只加载一次，光栅化器只持有共享句柄
+	AssetRegistry assets;
+	ModelHandle model_handle = assets.model(obj_path);
+	if (!model_handle) {
+		std::cerr << "cannot load " << obj_path << std::endl;
+		return 1;
 	}
+	model = model_handle.get();
 
 	std::cout << model->nfaces() << " " << model->nverts() << std::endl;
 
+	//注册表加载模型时已经生成了 LOD 链、meshlet 和 BVH：绘制时按模型在屏幕上的大小选择 LOD 并整块剔除 meshlet，BVH 用于阴影射线
+	if (bench_bvh) {
+		//分别测试最近交点和任意交点查询的吞吐量
+		for (bool any_hit : { false, true }) {
+			RayBenchmark bench = benchmark_bvh(model->bvh, model->mesh.bounds_min, model->mesh.bounds_max, 1 << 20, any_hit);
+			std::cout << (any_hit ? "any-hit " : "closest-hit ") << bench.rays << " rays, " << bench.hits << " hits, "
+				<< bench.seconds * 1000.0 << " ms, " << bench.rays_per_second() / 1e6 << " Mrays/s" << std::endl;
+		}
+		return 0;
+	}
+
 	//创建TGA图像
 	TGAImage image(width, height, TGAImage::Format::RGB);
 
@@ -361,18 +456,35 @@ int main(int argc, char** argv) {
 	rst::rasterizer r(width, height, 4);
 
 	//给定纹理并且设置
-	Texture tex("res/objs/african_head_diffuse.tga");
-	r.set_texture(tex);
+	r.set_texture(assets.texture("res/objs/african_head_diffuse.tga"));
 
 	//清空帧缓冲和zBuffer
 	r.clear(rst::Buffers::Color);
 	r.clear(rst::Buffers::Depth);
 
+	//剔除背面三角形，OBJ 模型以逆时针为正面
+	r.set_cull_mode(rst::CullMode::Back);
+
 	//设置MVP矩阵
 	r.set_model(modelMatrix());
 	r.set_view(viewMatrix());
 	r.set_projection(projectionMatrix());
 
+	//给出 --shadows 时，phong 着色向光源发射阴影射线，光源位置和着色点都在视图空间中，BVH 在模型空间中
+	if (shadows) {
+		Mat4f view = viewMatrix();
+		Mat4f model_matrix = modelMatrix();
+		Mat4f model_view = view * model_matrix;
+		view_to_model = model_view.affine_inverse();
+		shadow_bvh = &model->bvh;
+		//LOD 的误差是模型空间距离，视图矩阵是刚体变换，模型矩阵只做均匀缩放，按第一列的长度换算到视图空间
+		int lod = r.select_lod(model->mesh, model->lods);
+		if (lod > 0) {
+			Vec3f axis(model_view[0].x, model_view[1].x, model_view[2].x);
+			shadow_bias = base_shadow_bias + model->lods[lod - 1].error * axis.norm();
+		}
+	}
+
 	//设置顶点着色器和片元着色器
 	r.set_vertexShader(vertex_shader);
 	//r.set_fragmentShader(normal_fragment_shader); //法线着色
@@ -383,8 +495,11 @@ int main(int argc, char** argv) {
 	//r.set_fragmentShader(bump_fragment_shader); //凹凸纹理着色
 	//r.set_fragmentShader(displacement_fragment_shader); //凹凸纹理着色
 
-	//绘制模型
-	r.draw(model->TriangleList);
+	//绘制模型，投影到屏幕上的误差不超过 1 个像素的最粗 LOD，按 meshlet 剔除
+	r.draw(model->mesh, model->lods, model->meshlets);
+
+	//把超采样缓冲区解析到帧缓冲区
+	r.resolve();
 
 	//将frame_buffer帧缓冲中的颜色值写入image中
 	for (int i = 0; i < width; i++)
@@ -397,5 +512,4 @@ int main(int argc, char** argv) {
 	}
 	image.flip_vertically();
 	image.write_tga_file("output.tga");
-	delete model;
 }
\ No newline at end of file
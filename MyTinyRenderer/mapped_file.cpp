@@ -0,0 +1,99 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const char* filename) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return;
+	file_handle = file;
+	opened = true;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		close();
+		return;
+	}
+	length = static_cast<size_t>(file_size.QuadPart);
+	if (length == 0) return;
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		close();
+		return;
+	}
+	mapping_handle = mapping;
+	bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (bytes == nullptr) close();
+#else
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0) return;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return;
+	}
+	opened = true;
+	length = static_cast<size_t>(st.st_size);
+	if (length > 0) {
+		void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			opened = false;
+			length = 0;
+		}
+		else {
+			bytes = static_cast<const char*>(p);
+			// 解析器按顺序扫描整个文件，提示内核提前预读
+			madvise(p, length, MADV_SEQUENTIAL);
+		}
+	}
+	// 映射建立后文件描述符就不再需要了
+	::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		std::swap(bytes, other.bytes);
+		std::swap(length, other.length);
+		std::swap(opened, other.opened);
+#ifdef _WIN32
+		std::swap(file_handle, other.file_handle);
+		std::swap(mapping_handle, other.mapping_handle);
+#endif
+	}
+	return *this;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+	if (bytes) UnmapViewOfFile(bytes);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+#else
+	if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+	bytes = nullptr;
+	length = 0;
+	opened = false;
+}
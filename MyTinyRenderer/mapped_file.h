@@ -0,0 +1,58 @@
+/**
+
+@file mapped_file.h
+@brief 只读内存映射文件，Windows 下使用 CreateFileMapping，其他平台使用 mmap。
+*/
+#pragma once
+
+#include <cstddef>
+
+/**
+
+@brief 只读内存映射文件。对象存在期间整个文件都映射在内存中，析构时解除映射。
+*/
+class MappedFile
+{
+private:
+	const char* bytes = nullptr; // 映射区域的起始地址，空文件或打开失败时为 nullptr
+	size_t length = 0; // 文件长度（字节）
+	bool opened = false; // 文件是否成功打开
+#ifdef _WIN32
+	void* file_handle = nullptr; // 文件句柄
+	void* mapping_handle = nullptr; // 映射对象句柄
+#endif
+
+	/**
+	 * @brief 解除映射并关闭文件。
+	 */
+	void close();
+
+public:
+	MappedFile() = default;
+
+	/**
+	 * @brief 构造函数，以只读方式映射整个文件。
+	 * @param filename 文件路径。
+	 */
+	explicit MappedFile(const char* filename);
+
+	/**
+	 * @brief 析构函数，解除映射并关闭文件。
+	 */
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	/**
+	 * @brief 文件是否成功打开。空文件也算成功打开，此时 data() 为 nullptr。
+	 */
+	bool is_open() const { return opened; }
+
+	const char* data() const { return bytes; }
+
+	size_t size() const { return length; }
+};
@@ -0,0 +1,149 @@
+/**
+
+@file mesh.h
+@brief 索引网格：去重后的顶点属性流加 32 位索引缓冲区，共享顶点只存一份。
+*/
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <memory>
+#include <limits>
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+
+#include "geometry.h"
+#include "Triangle.h"
+
+/**
+
+@brief 网格的一个属性流或索引缓冲区。既可以自己持有数据（读取 OBJ 时逐个追加），
+也可以只引用外部内存（例如映射到内存的网格缓存文件），引用外部内存时是只读的。
+*/
+template <class T>
+class MeshBuffer
+{
+private:
+	std::vector<T> owned; // 自己持有的数据
+	const T* view = nullptr; // 引用的外部内存，为 nullptr 时使用 owned
+	size_t view_size = 0; // 外部内存中的元素个数
+
+public:
+	MeshBuffer() = default;
+
+	/**
+	 * @brief 接管一个数组作为自己持有的数据。
+	 */
+	explicit MeshBuffer(std::vector<T>&& data) : owned(std::move(data)) {}
+
+	/**
+	 * @brief 创建引用外部内存的缓冲区，外部内存的生命周期由调用者保证（见 Mesh::storage）。
+	 */
+	static MeshBuffer external(const T* data, size_t count)
+	{
+		MeshBuffer buffer;
+		buffer.view = count ? data : nullptr;
+		buffer.view_size = count;
+		return buffer;
+	}
+
+	bool is_external() const { return view != nullptr; }
+
+	size_t size() const { return view ? view_size : owned.size(); }
+
+	bool empty() const { return size() == 0; }
+
+	const T* data() const { return view ? view : owned.data(); }
+
+	const T* begin() const { return data(); }
+
+	const T* end() const { return data() + size(); }
+
+	const T& operator[](size_t i) const { return data()[i]; }
+
+	T& operator[](size_t i)
+	{
+		assert(!view && "external mesh buffers are read-only");
+		return owned[i];
+	}
+
+	void reserve(size_t count) { owned.reserve(count); }
+
+	void push_back(const T& value) { owned.push_back(value); }
+
+	template <class... Args>
+	void emplace_back(Args&&... args) { owned.emplace_back(std::forward<Args>(args)...); }
+};
+
+/**
+
+@brief 索引网格。第 i 个顶点的属性是 positions[i]、normals[i]、tex_coords[i]，
+第 t 个三角形的三个顶点是 indices[3t]、indices[3t + 1]、indices[3t + 2]。
+*/
+struct Mesh
+{
+	MeshBuffer<Vec3f> positions; // 模型空间顶点坐标，w 分量固定为 1，不单独存储
+	MeshBuffer<Vec3f> normals; // 顶点法向量，与 positions 等长
+	MeshBuffer<Vec2f> tex_coords; // 顶点纹理坐标，与 positions 等长
+	MeshBuffer<uint32_t> indices; // 三角形索引，长度是 3 的倍数
+	Vec3f bounds_min; // 模型空间包围盒的最小角
+	Vec3f bounds_max; // 模型空间包围盒的最大角
+	std::shared_ptr<const void> storage; // 缓冲区引用外部内存时，保证外部内存在网格（及其副本）存在期间有效
+
+	int vertex_count() const { return static_cast<int>(positions.size()); }
+
+	int triangle_count() const { return static_cast<int>(indices.size() / 3); }
+
+	/**
+	 * @brief 网格各个缓冲区占用的字节数。
+	 */
+	size_t memory_bytes() const
+	{
+		return positions.size() * sizeof(Vec3f) + normals.size() * sizeof(Vec3f)
+			+ tex_coords.size() * sizeof(Vec2f) + indices.size() * sizeof(uint32_t);
+	}
+
+	/**
+	 * @brief 由顶点坐标重新计算包围盒，没有顶点时包围盒为空（最小角大于最大角）。
+	 */
+	void compute_bounds()
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		bounds_min = Vec3f(inf, inf, inf);
+		bounds_max = Vec3f(-inf, -inf, -inf);
+		for (const Vec3f& p : positions) {
+			bounds_min = Vec3f(std::min(bounds_min.x, p.x), std::min(bounds_min.y, p.y), std::min(bounds_min.z, p.z));
+			bounds_max = Vec3f(std::max(bounds_max.x, p.x), std::max(bounds_max.y, p.y), std::max(bounds_max.z, p.z));
+		}
+	}
+
+	/**
+	 * @brief 组装第 t 个三角形，顶点颜色保持 Triangle 的默认值。
+	 */
+	Triangle triangle(int t) const
+	{
+		Triangle tri;
+		for (int k = 0; k < 3; k++) {
+			uint32_t i = indices[3 * t + k];
+			tri.v[k] = Vec4f(positions[i].x, positions[i].y, positions[i].z, 1.f);
+			tri.normal[k] = normals[i];
+			tri.texCoords[k] = tex_coords[i];
+		}
+		return tri;
+	}
+
+	/**
+	 * @brief 把网格展开成独立三角形列表，供不支持索引网格的代码使用。
+	 */
+	std::vector<Triangle> triangle_list() const
+	{
+		std::vector<Triangle> list;
+		list.reserve(triangle_count());
+		for (int t = 0; t < triangle_count(); t++) {
+			list.push_back(triangle(t));
+		}
+		return list;
+	}
+};
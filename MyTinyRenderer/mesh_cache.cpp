@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "mesh_cache.h"
+#include "mapped_file.h"
+
+namespace {
+
+	constexpr char mesh_cache_magic[8] = { 'T', 'R', 'M', 'E', 'S', 'H', 0, 0 };
+	constexpr uint64_t section_alignment = 16;
+
+	/**
+	 * @brief 64 位 FNV-1a 的变体，每次处理 8 个字节，足够检查文件是否被截断或损坏。
+	 */
+	static uint64_t checksum(const void* data, size_t bytes) {
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		uint64_t h = 1469598103934665603ull;
+		size_t i = 0;
+		for (; i + 8 <= bytes; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, p + i, 8);
+			h = (h ^ word) * 1099511628211ull;
+		}
+		for (; i < bytes; i++) {
+			h = (h ^ p[i]) * 1099511628211ull;
+		}
+		return h;
+	}
+
+	static uint64_t align_up(uint64_t offset) {
+		return (offset + section_alignment - 1) / section_alignment * section_alignment;
+	}
+
+	/**
+	 * @brief 读取源文件的大小和修改时间，源文件不存在时返回 false。
+	 */
+	static bool source_stamp(const char* source_path, uint64_t& size, int64_t& mtime) {
+		std::error_code ec;
+		const std::filesystem::path path(source_path);
+		size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+		if (ec) return false;
+		mtime = static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+		return !ec;
+	}
+
+	// 一段数据在文件中的范围是否合法
+	static bool section_ok(uint64_t offset, uint64_t count, uint64_t element_size, uint64_t file_size) {
+		return offset % section_alignment == 0 && offset <= file_size && count <= (file_size - offset) / element_size;
+	}
+
+} // namespace
+
+bool save_mesh_cache(const char* cache_path, const char* source_path, const Mesh& mesh, const ObjLoadInfo& info) {
+	MeshCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, mesh_cache_magic, sizeof(header.magic));
+	header.version = mesh_cache_version;
+	header.header_size = sizeof(MeshCacheHeader);
+	if (!source_stamp(source_path, header.source_size, header.source_mtime)) return false;
+	header.vertex_count = static_cast<uint32_t>(mesh.vertex_count());
+	header.index_count = static_cast<uint32_t>(mesh.indices.size());
+	header.obj_positions = static_cast<uint32_t>(info.positions);
+	header.obj_tex_coords = static_cast<uint32_t>(info.tex_coords);
+	header.obj_normals = static_cast<uint32_t>(info.normals);
+	header.obj_faces = static_cast<uint32_t>(info.faces);
+	const Vec3f* bounds[2] = { &mesh.bounds_min, &mesh.bounds_max };
+	float* dst[2] = { header.bounds_min, header.bounds_max };
+	for (int k = 0; k < 2; k++) {
+		dst[k][0] = bounds[k]->x;
+		dst[k][1] = bounds[k]->y;
+		dst[k][2] = bounds[k]->z;
+	}
+
+	// 各段数据依次排在头部之后，起点按 16 字节对齐
+	struct Section {
+		uint64_t* offset;
+		const void* data;
+		uint64_t bytes;
+	};
+	Section sections[4] = {
+		{ &header.positions_offset, mesh.positions.data(), mesh.positions.size() * sizeof(Vec3f) },
+		{ &header.normals_offset, mesh.normals.data(), mesh.normals.size() * sizeof(Vec3f) },
+		{ &header.tex_coords_offset, mesh.tex_coords.data(), mesh.tex_coords.size() * sizeof(Vec2f) },
+		{ &header.indices_offset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t) }
+	};
+	uint64_t offset = align_up(sizeof(MeshCacheHeader));
+	for (Section& s : sections) {
+		*s.offset = offset;
+		offset = align_up(offset + s.bytes);
+	}
+	header.file_size = offset;
+
+	// 数据部分的校验和按文件中的字节计算，包括对齐用的 0
+	std::vector<char> payload(header.file_size - sizeof(MeshCacheHeader), 0);
+	for (const Section& s : sections) {
+		if (s.bytes) std::memcpy(payload.data() + (*s.offset - sizeof(MeshCacheHeader)), s.data, s.bytes);
+	}
+	header.payload_checksum = checksum(payload.data(), payload.size());
+	header.header_checksum = checksum(&header, offsetof(MeshCacheHeader, header_checksum));
+
+	const std::string temp_path = std::string(cache_path) + ".tmp";
+	{
+		std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+		if (!out) {
+			out.close();
+			std::remove(temp_path.c_str());
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(temp_path, cache_path, ec);
+	if (ec) {
+		std::remove(temp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool load_mesh_cache(const char* cache_path, const char* source_path, Mesh& mesh, ObjLoadInfo* info, bool verify_payload) {
+	auto start = std::chrono::steady_clock::now();
+
+	auto file = std::make_shared<MappedFile>(cache_path);
+	if (!file->is_open() || file->size() < sizeof(MeshCacheHeader)) return false;
+
+	MeshCacheHeader header;
+	std::memcpy(&header, file->data(), sizeof(header));
+	if (std::memcmp(header.magic, mesh_cache_magic, sizeof(header.magic)) != 0 || header.version != mesh_cache_version
+		|| header.header_size != sizeof(MeshCacheHeader) || header.file_size != file->size()
+		|| header.header_checksum != checksum(&header, offsetof(MeshCacheHeader, header_checksum))) {
+		std::cerr << "mesh cache: " << cache_path << " is not a valid mesh cache" << std::endl;
+		return false;
+	}
+
+	// 源文件修改过就重新读取 OBJ；源文件不存在时仍然可以单独使用缓存
+	uint64_t source_size;
+	int64_t source_mtime;
+	if (source_stamp(source_path, source_size, source_mtime) && (source_size != header.source_size || source_mtime != header.source_mtime)) {
+		return false;
+	}
+
+	if (header.index_count % 3 != 0
+		|| !section_ok(header.positions_offset, header.vertex_count, sizeof(Vec3f), header.file_size)
+		|| !section_ok(header.normals_offset, header.vertex_count, sizeof(Vec3f), header.file_size)
+		|| !section_ok(header.tex_coords_offset, header.vertex_count, sizeof(Vec2f), header.file_size)
+		|| !section_ok(header.indices_offset, header.index_count, sizeof(uint32_t), header.file_size)) {
+		std::cerr << "mesh cache: " << cache_path << " has a corrupt layout" << std::endl;
+		return false;
+	}
+	// 索引只有一段，扫描一遍的代价远小于解析 OBJ；越界的索引会让之后的每个阶段读到映射区域之外
+	const uint32_t* indices = reinterpret_cast<const uint32_t*>(file->data() + header.indices_offset);
+	uint32_t max_index = 0;
+	for (uint32_t i = 0; i < header.index_count; i++) {
+		max_index = std::max(max_index, indices[i]);
+	}
+	if (header.index_count > 0 && max_index >= header.vertex_count) {
+		std::cerr << "mesh cache: " << cache_path << " has an index out of range" << std::endl;
+		return false;
+	}
+	if (verify_payload) {
+		const char* payload = file->data() + sizeof(MeshCacheHeader);
+		if (checksum(payload, file->size() - sizeof(MeshCacheHeader)) != header.payload_checksum) {
+			std::cerr << "mesh cache: " << cache_path << " failed the checksum" << std::endl;
+			return false;
+		}
+	}
+
+	const char* base = file->data();
+	Mesh result;
+	result.positions = MeshBuffer<Vec3f>::external(reinterpret_cast<const Vec3f*>(base + header.positions_offset), header.vertex_count);
+	result.normals = MeshBuffer<Vec3f>::external(reinterpret_cast<const Vec3f*>(base + header.normals_offset), header.vertex_count);
+	result.tex_coords = MeshBuffer<Vec2f>::external(reinterpret_cast<const Vec2f*>(base + header.tex_coords_offset), header.vertex_count);
+	result.indices = MeshBuffer<uint32_t>::external(indices, header.index_count);
+	result.bounds_min = Vec3f(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+	result.bounds_max = Vec3f(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+	result.storage = file;
+	mesh = std::move(result);
+
+	if (info) {
+		info->positions = static_cast<int>(header.obj_positions);
+		info->tex_coords = static_cast<int>(header.obj_tex_coords);
+		info->normals = static_cast<int>(header.obj_normals);
+		info->faces = static_cast<int>(header.obj_faces);
+		info->bytes = file->size();
+		info->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	return true;
+}
@@ -0,0 +1,81 @@
+/**
+
+@file mesh_cache.h
+@brief 二进制网格缓存：第一次读取 OBJ 后把索引网格原样写入缓存文件，之后直接把缓存文件映射到内存，
+网格的属性流和索引缓冲区引用映射区域，不需要解析也不需要拷贝。
+
+文件布局（小端）：MeshCacheHeader，然后是按 16 字节对齐的 positions、normals、tex_coords、indices 四段数据。
+头部记录了格式版本、源 OBJ 文件的大小和修改时间、包围盒、各段的偏移，以及头部和数据的校验和。
+*/
+#pragma once
+
+#include <cstdint>
+
+#include "mesh.h"
+#include "obj_loader.h"
+
+/**
+
+@brief 网格缓存文件头。
+*/
+struct MeshCacheHeader
+{
+	char magic[8]; // 固定为 "TRMESH" 加两个 '\0'
+	uint32_t version; // 格式版本，布局变化时递增
+	uint32_t header_size; // sizeof(MeshCacheHeader)
+	uint64_t source_size; // 源 OBJ 文件的大小，与当前源文件不一致时缓存失效
+	int64_t source_mtime; // 源 OBJ 文件的修改时间
+	uint32_t vertex_count; // 顶点数
+	uint32_t index_count; // 索引数
+	uint32_t obj_positions; // 源文件中 v、vt、vn、f 的行数，对应 ObjLoadInfo
+	uint32_t obj_tex_coords;
+	uint32_t obj_normals;
+	uint32_t obj_faces;
+	float bounds_min[3]; // 模型空间包围盒
+	float bounds_max[3];
+	uint64_t positions_offset; // 各段数据相对文件开头的偏移，都是 16 的倍数
+	uint64_t normals_offset;
+	uint64_t tex_coords_offset;
+	uint64_t indices_offset;
+	uint64_t file_size; // 整个缓存文件的大小
+	uint64_t payload_checksum; // 头部之后全部数据的校验和
+	uint64_t header_checksum; // 头部中此字段之前全部字节的校验和
+};
+
+// 顶点属性按内存中的字节原样写入和映射，布局变化时必须递增 mesh_cache_version
+static_assert(sizeof(Vec3f) == 12 && sizeof(Vec2f) == 8, "mesh cache stores Vec3f/Vec2f as packed floats");
+
+/**
+
+@brief 当前的网格缓存格式版本。版本 2 起缓存中保存的是经过 optimize_mesh 重排的网格。
+*/
+constexpr uint32_t mesh_cache_version = 2;
+
+/**
+
+@brief 把网格写入缓存文件。先写到临时文件再改名，写到一半失败或多个进程同时写时不会留下损坏的缓存。
+@param cache_path 缓存文件路径。
+@param source_path 源 OBJ 文件路径，记录它的大小和修改时间用于判断缓存是否过期。
+@param mesh 要写入的网格。
+@param info 源文件的统计信息，读取缓存时原样返回。
+@return 成功返回 true。
+*/
+bool save_mesh_cache(const char* cache_path, const char* source_path, const Mesh& mesh, const ObjLoadInfo& info);
+
+/**
+
+@brief 映射缓存文件并让网格直接引用其中的数据。
+
+会检查文件头的标识、版本、校验和和各段的范围；源文件存在时还要求它的大小和修改时间与缓存记录的一致，
+源文件不存在时直接使用缓存。索引总是逐个检查，任何索引不小于顶点数时拒绝缓存，所以损坏的缓存不会导致越界访问。
+数据部分的校验和要读完整个文件才能算出，只在 verify_payload 为 true 时检查；不检查时，顶点数据损坏不会被发现，
+渲染结果未定义（例如 NaN 坐标）。缓存可能被外部修改时应打开 verify_payload。
+
+@param cache_path 缓存文件路径。
+@param source_path 源 OBJ 文件路径。
+@param mesh 输出的网格，映射区域由 mesh.storage 持有。
+@param info 输出源文件的统计信息，seconds 和 bytes 是读取缓存的耗时和缓存文件大小，可以为 nullptr。
+@param verify_payload 是否检查数据部分的校验和。
+@return 缓存有效并成功映射时返回 true；缓存不存在、过期或损坏时返回 false，mesh 不变。
+*/
+bool load_mesh_cache(const char* cache_path, const char* source_path, Mesh& mesh, ObjLoadInfo* info = nullptr, bool verify_payload = false);
@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "mesh_optimizer.h"
+
+namespace {
+
+	/**
+	 * @brief 每个顶点相邻的三角形列表，按压缩行格式存放：顶点 v 的三角形是 triangles[offsets[v]] ... triangles[offsets[v + 1] - 1]。
+	 */
+	struct VertexAdjacency {
+		std::vector<int> offsets;
+		std::vector<int> triangles;
+
+		explicit VertexAdjacency(const Mesh& mesh) : offsets(mesh.vertex_count() + 1, 0), triangles(mesh.indices.size()) {
+			for (uint32_t v : mesh.indices) offsets[v + 1]++;
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+			std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+			for (int t = 0; t < mesh.triangle_count(); t++) {
+				for (int k = 0; k < 3; k++) {
+					triangles[fill[mesh.indices[3 * t + k]]++] = t;
+				}
+			}
+		}
+	};
+
+	/**
+	 * @brief FIFO 顶点缓存模拟器。
+	 */
+	struct FifoCache {
+		std::vector<int> time; // 顶点进入缓存时的计数，0 表示从未进入
+		int size;
+		int clock;
+
+		FifoCache(int vertex_count, int cache_size) : time(vertex_count, 0), size(cache_size), clock(cache_size + 1) {}
+
+		// 访问一个顶点，未命中时返回 true
+		bool access(uint32_t v) {
+			if (time[v] != 0 && clock - time[v] <= size) return false;
+			time[v] = clock++;
+			return true;
+		}
+	};
+
+	static Vec3f triangle_normal(const Mesh& mesh, const uint32_t* tri) {
+		const Vec3f& a = mesh.positions[tri[0]];
+		return (mesh.positions[tri[1]] - a) ^ (mesh.positions[tri[2]] - a);
+	}
+
+	static Vec3f triangle_centroid(const Mesh& mesh, const uint32_t* tri) {
+		return (mesh.positions[tri[0]] + mesh.positions[tri[1]] + mesh.positions[tri[2]]) * (1.f / 3.f);
+	}
+
+} // namespace
+
+float compute_acmr(const Mesh& mesh, int cache_size) {
+	if (mesh.triangle_count() == 0) return 0;
+	FifoCache cache(mesh.vertex_count(), cache_size);
+	int misses = 0;
+	for (uint32_t v : mesh.indices) misses += cache.access(v);
+	return static_cast<float>(misses) / mesh.triangle_count();
+}
+
+float estimate_overdraw(const Mesh& mesh, int resolution) {
+	if (mesh.triangle_count() == 0) return 0;
+
+	// 六个观察方向，每个方向给出屏幕的右、上和指向相机的方向，右 × 上 = 指向相机，屏幕上逆时针的三角形是正面
+	const Vec3f frames[6][3] = {
+		{ Vec3f(1, 0, 0), Vec3f(0, 1, 0), Vec3f(0, 0, 1) },
+		{ Vec3f(-1, 0, 0), Vec3f(0, 1, 0), Vec3f(0, 0, -1) },
+		{ Vec3f(0, 0, -1), Vec3f(0, 1, 0), Vec3f(1, 0, 0) },
+		{ Vec3f(0, 0, 1), Vec3f(0, 1, 0), Vec3f(-1, 0, 0) },
+		{ Vec3f(1, 0, 0), Vec3f(0, 0, -1), Vec3f(0, 1, 0) },
+		{ Vec3f(1, 0, 0), Vec3f(0, 0, 1), Vec3f(0, -1, 0) }
+	};
+
+	// 以包围盒的外接球把网格缩放到光栅范围内
+	const Vec3f center = (mesh.bounds_min + mesh.bounds_max) * 0.5f;
+	const float radius = std::max((mesh.bounds_max - mesh.bounds_min).norm() * 0.5f, std::numeric_limits<float>::min());
+	const float scale = resolution * 0.5f / radius;
+
+	std::vector<float> depth(static_cast<size_t>(resolution) * resolution);
+	double total = 0;
+	for (const auto& frame : frames) {
+		std::fill(depth.begin(), depth.end(), -std::numeric_limits<float>::infinity());
+		long long shaded = 0;
+		for (int t = 0; t < mesh.triangle_count(); t++) {
+			float x[3], y[3], z[3];
+			for (int k = 0; k < 3; k++) {
+				const Vec3f p = mesh.positions[mesh.indices[3 * t + k]] - center;
+				x[k] = (p * frame[0]) * scale + resolution * 0.5f;
+				y[k] = (p * frame[1]) * scale + resolution * 0.5f;
+				z[k] = p * frame[2];
+			}
+			const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (!(area > 0)) continue; // 背面和退化三角形
+			const int x0 = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+			const int x1 = std::min(resolution - 1, static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))));
+			const int y0 = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+			const int y1 = std::min(resolution - 1, static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))));
+			for (int py = y0; py <= y1; py++) {
+				for (int px = x0; px <= x1; px++) {
+					const float cx = px + 0.5f, cy = py + 0.5f;
+					const float w0 = (x[1] - cx) * (y[2] - cy) - (x[2] - cx) * (y[1] - cy);
+					const float w1 = (x[2] - cx) * (y[0] - cy) - (x[0] - cx) * (y[2] - cy);
+					const float w2 = (x[0] - cx) * (y[1] - cy) - (x[1] - cx) * (y[0] - cy);
+					if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+					const float pz = (w0 * z[0] + w1 * z[1] + w2 * z[2]) / area;
+					float& d = depth[static_cast<size_t>(py) * resolution + px];
+					if (pz > d) {
+						d = pz;
+						shaded++;
+					}
+				}
+			}
+		}
+		long long covered = 0;
+		for (float d : depth) covered += d != -std::numeric_limits<float>::infinity();
+		total += covered ? static_cast<double>(shaded) / covered : 1.0;
+	}
+	return static_cast<float>(total / 6);
+}
+
+void optimize_vertex_cache(Mesh& mesh, int cache_size, std::vector<int>* cluster_starts) {
+	// 读取都通过常量引用，网格可能引用只读的外部内存
+	const Mesh& in = mesh;
+	const int vertex_count = mesh.vertex_count();
+	const int triangle_count = mesh.triangle_count();
+	if (cluster_starts) cluster_starts->assign(1, 0);
+	if (triangle_count == 0) return;
+
+	// Tipsify（Sander 等，2007）：围绕一个扇心顶点输出它所有未输出的三角形，
+	// 然后在刚输出的顶点中选一个仍留在缓存中、且剩余三角形输出后不会把自己挤出缓存的顶点作为下一个扇心
+	const VertexAdjacency adjacency(mesh);
+	std::vector<int> live(vertex_count);
+	for (int v = 0; v < vertex_count; v++) live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	std::vector<int> cache_time(vertex_count, 0);
+	std::vector<char> emitted(triangle_count, 0);
+	std::vector<int> dead_end;
+	std::vector<int> candidates;
+	std::vector<int> order;
+	std::vector<char> hard_boundary(triangle_count + 1, 0);
+	order.reserve(triangle_count);
+	int clock = cache_size + 1;
+	int cursor = 0;
+
+	// 死胡同：先从最近输出的顶点里找还有剩余三角形的，再按编号顺序找
+	auto skip_dead_end = [&]() {
+		while (!dead_end.empty()) {
+			int d = dead_end.back();
+			dead_end.pop_back();
+			if (live[d] > 0) return d;
+		}
+		while (cursor < vertex_count) {
+			if (live[cursor] > 0) return cursor;
+			cursor++;
+		}
+		return -1;
+	};
+
+	int fan = skip_dead_end();
+	while (fan >= 0) {
+		candidates.clear();
+		for (int a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++) {
+			const int t = adjacency.triangles[a];
+			if (emitted[t]) continue;
+			for (int k = 0; k < 3; k++) {
+				const int v = static_cast<int>(in.indices[3 * t + k]);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (clock - cache_time[v] > cache_size) cache_time[v] = clock++;
+			}
+			emitted[t] = 1;
+			order.push_back(t);
+		}
+
+		int best = -1, best_priority = -1;
+		for (int v : candidates) {
+			if (live[v] <= 0) continue;
+			int priority = 0;
+			if (clock - cache_time[v] + 2 * live[v] <= cache_size) priority = clock - cache_time[v];
+			if (priority > best_priority) {
+				best = v;
+				best_priority = priority;
+			}
+		}
+		if (best < 0) {
+			best = skip_dead_end();
+			hard_boundary[order.size()] = 1;
+		}
+		fan = best;
+	}
+
+	std::vector<uint32_t> indices(mesh.indices.size());
+	for (int i = 0; i < triangle_count; i++) {
+		for (int k = 0; k < 3; k++) indices[3 * i + k] = in.indices[3 * order[i] + k];
+	}
+	mesh.indices = MeshBuffer<uint32_t>(std::move(indices));
+
+	if (!cluster_starts) return;
+	// 死胡同处一定分簇；此外当前簇的 ACMR 已经不高于整体水平、且下一个三角形的顶点全不在缓存中（缓存已刷新）时也分簇，
+	// 这样切开簇不会明显增加缓存未命中，又能得到足够细的簇供遮挡排序使用
+	const float threshold = compute_acmr(mesh, cache_size);
+	FifoCache cache(vertex_count, cache_size);
+	int cluster_misses = 0, cluster_size = 0;
+	for (int t = 0; t < triangle_count; t++) {
+		int misses = 0;
+		for (int k = 0; k < 3; k++) misses += cache.access(in.indices[3 * t + k]);
+		const bool flushed = misses == 3;
+		const bool soft = flushed && cluster_size > 0 && static_cast<float>(cluster_misses) / cluster_size <= threshold;
+		if (t > 0 && (hard_boundary[t] || soft)) {
+			cluster_starts->push_back(t);
+			cluster_misses = 0;
+			cluster_size = 0;
+		}
+		cluster_misses += misses;
+		cluster_size++;
+	}
+}
+
+void optimize_overdraw(Mesh& mesh, const std::vector<int>& cluster_starts) {
+	const Mesh& in = mesh;
+	const int triangle_count = mesh.triangle_count();
+	const int cluster_count = static_cast<int>(cluster_starts.size());
+	if (triangle_count == 0 || cluster_count <= 1) return;
+
+	// 网格中心：按面积加权的三角形重心
+	Vec3f mesh_center(0, 0, 0);
+	float mesh_area = 0;
+	std::vector<Vec3f> centers(cluster_count), normals(cluster_count);
+	for (int c = 0; c < cluster_count; c++) {
+		const int end = c + 1 < cluster_count ? cluster_starts[c + 1] : triangle_count;
+		Vec3f center(0, 0, 0), normal(0, 0, 0);
+		float area = 0;
+		for (int t = cluster_starts[c]; t < end; t++) {
+			const uint32_t* tri = &in.indices[3 * t];
+			const Vec3f n = triangle_normal(in, tri);
+			const float a = n.norm();
+			center = center + triangle_centroid(in, tri) * a;
+			normal = normal + n;
+			area += a;
+		}
+		mesh_center = mesh_center + center;
+		mesh_area += area;
+		centers[c] = area > 0 ? center / area : triangle_centroid(in, &in.indices[3 * cluster_starts[c]]);
+		normals[c] = normal;
+	}
+	if (mesh_area > 0) mesh_center = mesh_center / mesh_area;
+
+	std::vector<float> key(cluster_count);
+	for (int c = 0; c < cluster_count; c++) {
+		const float len = normals[c].norm();
+		key[c] = len > 0 ? ((centers[c] - mesh_center) * normals[c]) / len : 0.f;
+	}
+	std::vector<int> order(cluster_count);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return key[a] > key[b]; });
+
+	std::vector<uint32_t> indices;
+	indices.reserve(mesh.indices.size());
+	for (int c : order) {
+		const int end = c + 1 < cluster_count ? cluster_starts[c + 1] : triangle_count;
+		indices.insert(indices.end(), in.indices.begin() + 3 * cluster_starts[c], in.indices.begin() + 3 * end);
+	}
+	mesh.indices = MeshBuffer<uint32_t>(std::move(indices));
+}
+
+void optimize_vertex_fetch(Mesh& mesh) {
+	const Mesh& in = mesh;
+	const uint32_t unused = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> remap(mesh.vertex_count(), unused);
+	std::vector<Vec3f> positions, normals;
+	std::vector<Vec2f> tex_coords;
+	std::vector<uint32_t> indices(mesh.indices.size());
+	positions.reserve(mesh.vertex_count());
+	normals.reserve(mesh.vertex_count());
+	tex_coords.reserve(mesh.vertex_count());
+	for (size_t i = 0; i < mesh.indices.size(); i++) {
+		const uint32_t v = in.indices[i];
+		if (remap[v] == unused) {
+			remap[v] = static_cast<uint32_t>(positions.size());
+			positions.push_back(in.positions[v]);
+			normals.push_back(in.normals[v]);
+			tex_coords.push_back(in.tex_coords[v]);
+		}
+		indices[i] = remap[v];
+	}
+	mesh.positions = MeshBuffer<Vec3f>(std::move(positions));
+	mesh.normals = MeshBuffer<Vec3f>(std::move(normals));
+	mesh.tex_coords = MeshBuffer<Vec2f>(std::move(tex_coords));
+	mesh.indices = MeshBuffer<uint32_t>(std::move(indices));
+	// 所有缓冲区都已经是自己持有的数据，不再需要外部内存
+	mesh.storage.reset();
+	mesh.compute_bounds();
+}
+
+MeshOptimizeReport optimize_mesh(Mesh& mesh, int cache_size) {
+	MeshOptimizeReport report;
+	report.acmr_before = compute_acmr(mesh, cache_size);
+	report.overdraw_before = estimate_overdraw(mesh);
+
+	std::vector<int> cluster_starts;
+	optimize_vertex_cache(mesh, cache_size, &cluster_starts);
+	optimize_overdraw(mesh, cluster_starts);
+	optimize_vertex_fetch(mesh);
+
+	report.clusters = static_cast<int>(cluster_starts.size());
+	report.acmr_after = compute_acmr(mesh, cache_size);
+	report.overdraw_after = estimate_overdraw(mesh);
+	return report;
+}
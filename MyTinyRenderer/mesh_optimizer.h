@@ -0,0 +1,75 @@
+/**
+
+@file mesh_optimizer.h
+@brief 索引网格的三角形重排：按变换后顶点缓存的命中率（Tipsify）和前后遮挡关系重新排列三角形，
+并按首次使用的顺序重排顶点，另外提供 ACMR 和过度绘制的估计，用于比较优化前后的效果。
+*/
+#pragma once
+
+#include <vector>
+
+#include "mesh.h"
+
+/**
+
+@brief 一次网格优化前后的统计。
+*/
+struct MeshOptimizeReport
+{
+	float acmr_before = 0; // 平均每个三角形的顶点缓存未命中数（ACMR），越接近 0.5 越好，最差是 3
+	float acmr_after = 0;
+	float overdraw_before = 0; // 估计的过度绘制：通过深度测试的片元数 / 被覆盖的像素数，最好是 1
+	float overdraw_after = 0;
+	int clusters = 0; // 重排遮挡顺序时的簇数
+};
+
+/**
+
+@brief 模拟一个 FIFO 顶点缓存，计算按索引顺序绘制时的 ACMR。
+@param mesh 网格。
+@param cache_size 缓存能容纳的顶点数。
+@return 顶点缓存未命中数 / 三角形数，没有三角形时返回 0。
+*/
+float compute_acmr(const Mesh& mesh, int cache_size = 16);
+
+/**
+
+@brief 估计按索引顺序绘制时的过度绘制。从 ±X、±Y、±Z 六个方向做正交投影，剔除背面后按顺序光栅化，
+统计通过深度测试的片元数与最终被覆盖的像素数之比，六个方向取平均。
+@param mesh 网格。
+@param resolution 每个方向的光栅分辨率。
+*/
+float estimate_overdraw(const Mesh& mesh, int resolution = 256);
+
+/**
+
+@brief 用 Tipsify 算法重排三角形，提高变换后顶点缓存的命中率。
+@param mesh 网格，索引缓冲区被替换为重排后的结果。
+@param cache_size 目标顶点缓存大小。
+@param cluster_starts 输出的簇划分：每个簇第一个三角形的编号，第一个是 0。
+遇到死胡同（当前顶点周围没有未输出的三角形）时开始新簇；缓存在簇内已基本刷新、且簇的 ACMR 足够低时也开始新簇。可以为 nullptr。
+*/
+void optimize_vertex_cache(Mesh& mesh, int cache_size = 16, std::vector<int>* cluster_starts = nullptr);
+
+/**
+
+@brief 在不打散簇的前提下重排簇的绘制顺序来减少过度绘制：按簇的朝外程度（簇中心到网格中心的向量与簇平均法向量的点积）
+从大到小排列，越靠外、越朝外的簇越先画，更容易挡住后面的簇。与视角无关，对各个方向都有效。
+@param mesh 网格，索引缓冲区被替换为重排后的结果。
+@param cluster_starts optimize_vertex_cache 输出的簇划分。
+*/
+void optimize_overdraw(Mesh& mesh, const std::vector<int>& cluster_starts);
+
+/**
+
+@brief 按顶点在索引缓冲区中首次出现的顺序重排顶点，使顶点数据的读取尽量连续。没有被引用的顶点会被删除。
+*/
+void optimize_vertex_fetch(Mesh& mesh);
+
+/**
+
+@brief 依次执行 optimize_vertex_cache、optimize_overdraw 和 optimize_vertex_fetch，并返回优化前后的统计。
+@param mesh 网格。引用外部内存（例如映射的缓存文件）的缓冲区会被替换为自己持有的数据。
+@param cache_size 目标顶点缓存大小。
+*/
+MeshOptimizeReport optimize_mesh(Mesh& mesh, int cache_size = 16);
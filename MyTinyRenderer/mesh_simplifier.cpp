@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+
+namespace {
+
+	constexpr uint32_t invalid_vertex = std::numeric_limits<uint32_t>::max();
+	constexpr double boundary_weight = 10.0; // 边界和接缝约束平面相对于三角形平面的权重
+
+	/**
+	 * @brief 二次误差：到一组平面的距离平方的加权和，用对称 4x4 矩阵的 10 个独立元素表示。
+	 * 同时记录权重之和，误差除以权重就是平均距离的平方，与网格的三角形数无关。
+	 */
+	struct Quadric {
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double weight = 0;
+
+		// 累加平面 n·p + d = 0，n 是单位向量
+		void add_plane(const Vec3f& n, double d, double w) {
+			a00 += w * n.x * n.x;
+			a01 += w * n.x * n.y;
+			a02 += w * n.x * n.z;
+			a11 += w * n.y * n.y;
+			a12 += w * n.y * n.z;
+			a22 += w * n.z * n.z;
+			b0 += w * n.x * d;
+			b1 += w * n.y * d;
+			b2 += w * n.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric& q) {
+			a00 += q.a00;
+			a01 += q.a01;
+			a02 += q.a02;
+			a11 += q.a11;
+			a12 += q.a12;
+			a22 += q.a22;
+			b0 += q.b0;
+			b1 += q.b1;
+			b2 += q.b2;
+			c += q.c;
+			weight += q.weight;
+		}
+
+		// 点 p 到各个平面的平均距离平方
+		double error(const Vec3f& p) const {
+			if (weight <= 0) return 0;
+			const double x = p.x, y = p.y, z = p.z;
+			const double r = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2 * (b0 * x + b1 * y + b2 * z) + c;
+			return std::max(r, 0.0) / weight;
+		}
+	};
+
+	/**
+	 * @brief 顶点的类型，决定它可以沿哪些边折叠。
+	 */
+	enum class VertexKind : unsigned char {
+		Manifold, // 内部顶点，可以折叠到任意相邻顶点
+		Border, // 开放边界上的顶点，只能沿边界折叠到另一个边界顶点
+		Seam, // 接缝上的顶点（同一位置恰好有两个属性不同的顶点），两侧只能沿接缝一起折叠
+		Locked // 角点、多条接缝的交点和非流形顶点，不折叠
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	static uint64_t edge_key(uint32_t a, uint32_t b) {
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	static Vec3f face_normal(const Vec3f& a, const Vec3f& b, const Vec3f& c) {
+		return (b - a) ^ (c - a);
+	}
+
+	/**
+	 * @brief 简化过程中的网格状态。顶点坐标和属性始终不变，折叠只修改索引。
+	 */
+	struct Simplifier {
+		const Mesh& mesh;
+		int vertex_count;
+		std::vector<uint32_t> indices;
+		std::vector<uint32_t> group; // 位置相同的顶点组成一组，group[v] 是组中编号最小的顶点
+		std::vector<uint32_t> twin; // 接缝顶点在另一侧的对应顶点
+		std::vector<VertexKind> kind;
+		std::vector<uint32_t> open_next; // 沿开放边（只有一个三角形使用的有向边）的下一个和上一个顶点
+		std::vector<uint32_t> open_prev;
+		std::vector<Quadric> quadrics; // 按 group 索引
+		std::vector<int> offsets; // 当前索引下每个顶点相邻的三角形，压缩行格式
+		std::vector<int> fans;
+		std::vector<uint32_t> scratch[3]; // keeps_manifold 的临时数组，避免每次检查都分配内存
+
+		explicit Simplifier(const Mesh& in) : mesh(in), vertex_count(in.vertex_count()), indices(in.indices.begin(), in.indices.end()) {
+			classify_vertices();
+			accumulate_quadrics();
+		}
+
+		int triangle_count() const { return static_cast<int>(indices.size() / 3); }
+
+		void classify_vertices() {
+			// 按坐标排序后相邻的相同坐标就是一组
+			std::vector<uint32_t> order(vertex_count);
+			std::iota(order.begin(), order.end(), 0u);
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+				const Vec3f& p = mesh.positions[a];
+				const Vec3f& q = mesh.positions[b];
+				if (p.x != q.x) return p.x < q.x;
+				if (p.y != q.y) return p.y < q.y;
+				if (p.z != q.z) return p.z < q.z;
+				return a < b;
+			});
+			group.assign(vertex_count, 0);
+			twin.assign(vertex_count, invalid_vertex);
+			std::vector<int> group_size(vertex_count, 0);
+			for (int i = 0; i < vertex_count;) {
+				int j = i + 1;
+				while (j < vertex_count && mesh.positions[order[j]].x == mesh.positions[order[i]].x
+					&& mesh.positions[order[j]].y == mesh.positions[order[i]].y && mesh.positions[order[j]].z == mesh.positions[order[i]].z) {
+					j++;
+				}
+				for (int k = i; k < j; k++) group[order[k]] = order[i];
+				group_size[order[i]] = j - i;
+				if (j - i == 2) {
+					twin[order[i]] = order[i + 1];
+					twin[order[i + 1]] = order[i];
+				}
+				i = j;
+			}
+
+			// 有两个顶点位置相同的三角形面积为 0，不影响绘制结果，却会在拓扑上制造多余的开放边
+			remove_degenerate(indices);
+
+			std::unordered_set<uint64_t> edges;
+			edges.reserve(indices.size());
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				for (int k = 0; k < 3; k++) edges.insert(edge_key(indices[i + k], indices[i + (k + 1) % 3]));
+			}
+			open_next.assign(vertex_count, invalid_vertex);
+			open_prev.assign(vertex_count, invalid_vertex);
+			std::vector<unsigned char> open_out(vertex_count, 0), open_in(vertex_count, 0);
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				for (int k = 0; k < 3; k++) {
+					const uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+					if (edges.count(edge_key(b, a))) continue;
+					open_next[a] = b;
+					open_prev[b] = a;
+					open_out[a] = static_cast<unsigned char>(std::min(open_out[a] + 1, 2));
+					open_in[b] = static_cast<unsigned char>(std::min(open_in[b] + 1, 2));
+				}
+			}
+
+			kind.assign(vertex_count, VertexKind::Locked);
+			for (int v = 0; v < vertex_count; v++) {
+				const int size = group_size[group[v]];
+				const bool open = open_out[v] || open_in[v];
+				const bool chain = open_out[v] == 1 && open_in[v] == 1;
+				if (size == 1 && !open) kind[v] = VertexKind::Manifold;
+				else if (size == 1 && chain) kind[v] = VertexKind::Border;
+				else if (size == 2 && chain && open_out[twin[v]] == 1 && open_in[twin[v]] == 1) kind[v] = VertexKind::Seam;
+			}
+		}
+
+		void remove_degenerate(std::vector<uint32_t>& triangles) const {
+			size_t write = 0;
+			for (size_t i = 0; i < triangles.size(); i += 3) {
+				const uint32_t a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+				if (group[a] == group[b] || group[b] == group[c] || group[c] == group[a]) continue;
+				triangles[write++] = a;
+				triangles[write++] = b;
+				triangles[write++] = c;
+			}
+			triangles.resize(write);
+		}
+
+		void accumulate_quadrics() {
+			quadrics.assign(vertex_count, Quadric());
+			std::unordered_set<uint64_t> edges;
+			edges.reserve(indices.size());
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				for (int k = 0; k < 3; k++) edges.insert(edge_key(indices[i + k], indices[i + (k + 1) % 3]));
+			}
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				const uint32_t* tri = &indices[i];
+				const Vec3f& p0 = mesh.positions[tri[0]];
+				Vec3f n = face_normal(p0, mesh.positions[tri[1]], mesh.positions[tri[2]]);
+				const float length = n.norm();
+				if (!(length > 0)) continue;
+				n = n / length;
+				// 三角形所在平面，按面积加权
+				for (int k = 0; k < 3; k++) quadrics[group[tri[k]]].add_plane(n, -(n * p0), length * 0.5);
+
+				// 开放边额外加一个过该边、垂直于三角形的平面，使边界和接缝尽量保持原来的形状
+				for (int k = 0; k < 3; k++) {
+					const uint32_t a = tri[k], b = tri[(k + 1) % 3];
+					if (edges.count(edge_key(b, a))) continue;
+					const Vec3f& pa = mesh.positions[a];
+					const Vec3f e = mesh.positions[b] - pa;
+					Vec3f m = e ^ n;
+					const float m_length = m.norm();
+					if (!(m_length > 0)) continue;
+					m = m / m_length;
+					const double w = static_cast<double>(e * e) * boundary_weight;
+					quadrics[group[a]].add_plane(m, -(m * pa), w);
+					quadrics[group[b]].add_plane(m, -(m * pa), w);
+				}
+			}
+		}
+
+		void build_fans() {
+			offsets.assign(vertex_count + 1, 0);
+			for (uint32_t v : indices) offsets[v + 1]++;
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+			fans.resize(indices.size());
+			std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+			for (int t = 0; t < triangle_count(); t++) {
+				for (int k = 0; k < 3; k++) fans[fill[indices[3 * t + k]]++] = t;
+			}
+		}
+
+		// u 和 v 是否沿开放边相邻，并且折叠后边界环还至少有三个顶点
+		bool open_neighbors(uint32_t u, uint32_t v) const {
+			if (open_next[u] == v) return open_prev[u] != open_next[v];
+			if (open_prev[u] == v) return open_next[u] != open_prev[v];
+			return false;
+		}
+
+		bool can_collapse(uint32_t u, uint32_t v) const {
+			if (group[u] == group[v]) return false;
+			switch (kind[u]) {
+			case VertexKind::Manifold:
+				return true;
+			case VertexKind::Border:
+				return kind[v] == VertexKind::Border && open_neighbors(u, v);
+			case VertexKind::Seam:
+				return kind[v] == VertexKind::Seam && open_neighbors(u, v) && open_neighbors(twin[u], twin[v]);
+			default:
+				return false;
+			}
+		}
+
+		double collapse_cost(uint32_t u, uint32_t v) const {
+			Quadric q = quadrics[group[u]];
+			q.add(quadrics[group[v]]);
+			const Vec3f& pu = mesh.positions[u];
+			const Vec3f& pv = mesh.positions[v];
+			double cost = q.error(pv);
+			// u 的三角形改用 v 的法向量，法向量差别越大、边越长，着色的变化越明显
+			const Vec3f d = pv - pu;
+			double bend = 1.0 - mesh.normals[u] * mesh.normals[v];
+			if (kind[u] == VertexKind::Seam) bend = std::max(bend, 1.0 - mesh.normals[twin[u]] * mesh.normals[twin[v]]);
+			return cost + std::max(bend, 0.0) * (d * d);
+		}
+
+		// 把 u 移到 v 的位置后，u 周围不包含 v 的三角形是否会翻转或退化
+		bool flips(uint32_t u, uint32_t v) const {
+			const Vec3f& pv = mesh.positions[v];
+			for (int i = offsets[u]; i < offsets[u + 1]; i++) {
+				const uint32_t* tri = &indices[3 * fans[i]];
+				if (tri[0] == v || tri[1] == v || tri[2] == v) continue;
+				Vec3f p[3];
+				for (int k = 0; k < 3; k++) p[k] = mesh.positions[tri[k]];
+				const Vec3f before = face_normal(p[0], p[1], p[2]);
+				for (int k = 0; k < 3; k++) {
+					if (tri[k] == u) p[k] = pv;
+				}
+				const Vec3f after = face_normal(p[0], p[1], p[2]);
+				if (before * after <= 1e-2f * before.norm() * after.norm()) return true;
+			}
+			return false;
+		}
+
+		/**
+		 * @brief 连接条件：u 和 v 的公共相邻位置只能是包含边 uv 的三角形的第三个顶点，否则折叠会把网格粘成非流形（例如压扁一个四面体）。
+		 * 按位置组比较，接缝两侧的顶点算作同一个位置。
+		 */
+		bool keeps_manifold(uint32_t u, uint32_t v) {
+			std::vector<uint32_t>& around_u = scratch[0];
+			std::vector<uint32_t>& around_v = scratch[1];
+			std::vector<uint32_t>& shared = scratch[2];
+			around_u.clear();
+			around_v.clear();
+			shared.clear();
+			auto gather = [&](uint32_t x, std::vector<uint32_t>& out) {
+				for (int i = offsets[x]; i < offsets[x + 1]; i++) {
+					const uint32_t* tri = &indices[3 * fans[i]];
+					for (int k = 0; k < 3; k++) {
+						if (group[tri[k]] != group[u] && group[tri[k]] != group[v]) out.push_back(group[tri[k]]);
+					}
+				}
+				std::sort(out.begin(), out.end());
+				out.erase(std::unique(out.begin(), out.end()), out.end());
+			};
+			gather(u, around_u);
+			gather(v, around_v);
+			std::set_intersection(around_u.begin(), around_u.end(), around_v.begin(), around_v.end(), std::back_inserter(shared));
+			// 包含边 uv 的三角形的第三个顶点
+			for (int i = offsets[u]; i < offsets[u + 1]; i++) {
+				const uint32_t* tri = &indices[3 * fans[i]];
+				if (tri[0] != v && tri[1] != v && tri[2] != v) continue;
+				for (int k = 0; k < 3; k++) {
+					auto it = std::lower_bound(shared.begin(), shared.end(), group[tri[k]]);
+					if (it != shared.end() && *it == group[tri[k]]) shared.erase(it);
+				}
+			}
+			return shared.empty();
+		}
+
+		// 折叠会删除的三角形数：u 周围同时包含 v 的三角形
+		int shared_triangles(uint32_t u, uint32_t v) const {
+			int count = 0;
+			for (int i = offsets[u]; i < offsets[u + 1]; i++) {
+				const uint32_t* tri = &indices[3 * fans[i]];
+				count += tri[0] == v || tri[1] == v || tri[2] == v;
+			}
+			return count;
+		}
+
+		// u 和它周围三角形的顶点在本轮中不能再参与折叠，保证本轮的翻转检查和三角形计数都基于未修改的邻域
+		void touch(std::vector<unsigned char>& touched, uint32_t u) const {
+			for (int i = offsets[u]; i < offsets[u + 1]; i++) {
+				const uint32_t* tri = &indices[3 * fans[i]];
+				for (int k = 0; k < 3; k++) touched[tri[k]] = 1;
+			}
+		}
+
+		// 沿开放边把 u 折叠到 v 后，v 接替 u 在边界环中的位置
+		void relink(uint32_t u, uint32_t v) {
+			if (open_next[u] == v) {
+				open_next[open_prev[u]] = v;
+				open_prev[v] = open_prev[u];
+			}
+			else {
+				open_prev[open_next[u]] = v;
+				open_next[v] = open_next[u];
+			}
+		}
+
+		/**
+		 * @brief 简化到目标三角形数。每一轮按代价从小到大执行互不相邻的折叠，然后统一改写索引，直到达到目标或者不能再折叠。
+		 * @return 执行过的折叠中最大的代价。
+		 */
+		double run(int target_triangles, double error_limit) {
+			std::vector<uint32_t> remap(vertex_count);
+			std::iota(remap.begin(), remap.end(), 0u);
+			std::vector<unsigned char> touched(vertex_count);
+			std::vector<Collapse> candidates;
+			double max_cost = 0;
+			bool relax = false;
+
+			while (triangle_count() > target_triangles) {
+				build_fans();
+				candidates.clear();
+				for (size_t i = 0; i < indices.size(); i += 3) {
+					for (int k = 0; k < 3; k++) {
+						const uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+						// 内部的边被两个三角形各用一次，只从其中一个三角形生成；开放边只出现一次，必须保留
+						if (a > b && (kind[a] == VertexKind::Manifold || kind[b] == VertexKind::Manifold)) continue;
+						if (can_collapse(a, b)) candidates.push_back({ a, b, collapse_cost(a, b) });
+						if (can_collapse(b, a)) candidates.push_back({ b, a, collapse_cost(b, a) });
+					}
+				}
+				if (candidates.empty()) break;
+				std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+				// 每轮只考虑代价最小的一部分折叠，避免为了凑够数量而执行代价大的折叠；这部分全部被翻转检查挡住时下一轮放开限制
+				const int needed = triangle_count() - target_triangles;
+				const double pass_limit = relax ? std::numeric_limits<double>::infinity()
+					: candidates[std::min(candidates.size() - 1, static_cast<size_t>(needed) * 2)].cost;
+
+				std::fill(touched.begin(), touched.end(), 0);
+				int removed = 0;
+				int collapses = 0;
+				for (const Collapse& c : candidates) {
+					if (removed >= needed || c.cost > error_limit || c.cost > pass_limit) break;
+					const uint32_t u = c.from, v = c.to;
+					const bool seam = kind[u] == VertexKind::Seam;
+					if (touched[u] || touched[v] || (seam && (touched[twin[u]] || touched[twin[v]]))) continue;
+					if (flips(u, v) || (seam && flips(twin[u], twin[v])) || !keeps_manifold(u, v)) continue;
+
+					removed += shared_triangles(u, v);
+					touch(touched, u);
+					touched[v] = 1;
+					remap[u] = v;
+					if (seam) {
+						removed += shared_triangles(twin[u], twin[v]);
+						touch(touched, twin[u]);
+						touched[twin[v]] = 1;
+						remap[twin[u]] = twin[v];
+						relink(twin[u], twin[v]);
+					}
+					if (kind[u] != VertexKind::Manifold) relink(u, v);
+					quadrics[group[v]].add(quadrics[group[u]]);
+					max_cost = std::max(max_cost, c.cost);
+					collapses++;
+				}
+				if (collapses == 0) {
+					if (relax) break;
+					relax = true;
+					continue;
+				}
+				relax = false;
+
+				// 改写索引并删除折叠后退化的三角形
+				for (uint32_t& v : indices) v = remap[v];
+				remove_degenerate(indices);
+			}
+			return max_cost;
+		}
+	};
+
+} // namespace
+
+float simplify_mesh(const Mesh& mesh, Mesh& result, int target_triangles, float target_error) {
+	Simplifier simplifier(mesh);
+	const double limit = static_cast<double>(target_error) * target_error;
+	const double cost = simplifier.run(std::max(target_triangles, 0), limit);
+
+	Mesh simplified;
+	simplified.positions = MeshBuffer<Vec3f>(std::vector<Vec3f>(mesh.positions.begin(), mesh.positions.end()));
+	simplified.normals = MeshBuffer<Vec3f>(std::vector<Vec3f>(mesh.normals.begin(), mesh.normals.end()));
+	simplified.tex_coords = MeshBuffer<Vec2f>(std::vector<Vec2f>(mesh.tex_coords.begin(), mesh.tex_coords.end()));
+	simplified.indices = MeshBuffer<uint32_t>(std::move(simplifier.indices));
+	// 折叠打乱了原来的三角形顺序，重新按顶点缓存排序，并删除不再被引用的顶点
+	optimize_vertex_cache(simplified);
+	optimize_vertex_fetch(simplified);
+	result = std::move(simplified);
+	return static_cast<float>(std::sqrt(cost));
+}
+
+std::vector<MeshLod> build_lod_chain(const Mesh& mesh, int max_levels, float reduction, int min_triangles, float max_error) {
+	std::vector<MeshLod> lods;
+	lods.reserve(std::max(max_levels, 0)); // source 指向上一级，不能因为扩容而失效
+	const float error_budget = max_error * (mesh.bounds_max - mesh.bounds_min).norm() * 0.5f;
+	const Mesh* source = &mesh;
+	float error = 0;
+	for (int level = 0; level < max_levels; level++) {
+		const int current = source->triangle_count();
+		const int target = static_cast<int>(current * reduction);
+		if (target < min_triangles || !(error < error_budget)) break;
+		MeshLod lod;
+		const float level_error = simplify_mesh(*source, lod.mesh, target, error_budget - error);
+		// 接缝、边界或误差上限把简化卡住时，再往下生成只会得到几乎相同的网格
+		if (current - lod.mesh.triangle_count() < (current - target) / 2) break;
+		error += level_error;
+		lod.error = error;
+		lods.push_back(std::move(lod));
+		source = &lods.back().mesh;
+	}
+	return lods;
+}
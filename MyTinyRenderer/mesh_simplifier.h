@@ -0,0 +1,48 @@
+/**
+
+@file mesh_simplifier.h
+@brief 基于二次误差度量（QEM）的网格简化和 LOD 链生成。
+
+简化使用半边折叠：把顶点 u 折叠到相邻顶点 v 上，保留下来的顶点的坐标、法向量和纹理坐标都不变，
+所以简化后的网格不会产生新的属性值。位置相同而属性不同的顶点（UV 接缝和法向量不连续的硬边）组成接缝，
+接缝上的顶点只能沿接缝成对折叠，开放边界上的顶点只能沿边界折叠，接缝和边界的形状由附加的约束平面保持。
+*/
+#pragma once
+
+#include <vector>
+
+#include "mesh.h"
+
+/**
+
+@brief LOD 链中的一级。
+*/
+struct MeshLod
+{
+	Mesh mesh; // 简化后的网格，已经按顶点缓存和顶点读取顺序优化
+	float error = 0; // 相对原始网格的几何误差估计（模型空间距离），随级别单调递增
+};
+
+/**
+
+@brief 用二次误差度量逐步折叠边，直到三角形数不超过目标值或者误差超过上限。
+@param mesh 要简化的网格，不会被修改。
+@param result 输出的简化网格，只包含被引用的顶点，缓冲区都是自己持有的数据。
+@param target_triangles 目标三角形数。接缝、边界和翻转检查可能使简化提前停止，结果可能多于目标值。
+@param target_error 允许的最大误差（模型空间距离），默认不限制。
+@return 简化引入的误差估计：执行过的折叠中最大的二次误差的平方根。
+*/
+float simplify_mesh(const Mesh& mesh, Mesh& result, int target_triangles, float target_error = 1e30f);
+
+/**
+
+@brief 生成 LOD 链。每一级由上一级简化而来，三角形数乘以 reduction，误差逐级累加。
+三角形数少于 min_triangles、累计误差达到上限，或者某一级简化不下去（三角形数减少不到一半的预期）时停止。
+@param mesh 原始网格（第 0 级，不包含在返回值中）。
+@param max_levels 最多生成的级数。
+@param reduction 每一级相对上一级的三角形数比例。
+@param min_triangles 最粗一级的最少三角形数。
+@param max_error 累计误差的上限，相对于包围盒外接球的半径。误差再大的 LOD 只有在模型缩到几个像素时才会被选中，不值得保存。
+@return 从细到粗排列的 LOD，第 i 个元素是第 i + 1 级。
+*/
+std::vector<MeshLod> build_lod_chain(const Mesh& mesh, int max_levels = 6, float reduction = 0.5f, int min_triangles = 64, float max_error = 0.05f);
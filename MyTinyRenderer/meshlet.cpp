@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "meshlet.h"
+
+namespace {
+
+	/**
+	 * @brief 贪心切分 meshlet 的状态。每个顶点的相邻三角形列表按压缩行格式存放，
+	 * 三角形加入 meshlet 后立即从三个顶点的列表中移除，列表中只剩下还没有加入任何 meshlet 的三角形。
+	 */
+	struct MeshletBuilder {
+		const Mesh& mesh;
+		const int max_vertices;
+		const int max_triangles;
+		const float cone_weight;
+
+		std::vector<int> offsets; // 顶点 v 的相邻三角形是 adjacency[offsets[v]] ... adjacency[offsets[v] + live[v] - 1]
+		std::vector<int> adjacency;
+		std::vector<int> live; // 每个顶点还没有加入 meshlet 的相邻三角形数
+		std::vector<Vec3f> normals; // 三角形的单位法向量，退化三角形是零向量
+		std::vector<Vec3f> centroids; // 三角形的重心
+		std::vector<char> emitted; // 三角形是否已经加入 meshlet
+		std::vector<int> local; // 顶点在当前 meshlet 中的局部编号，不在当前 meshlet 中时为 -1
+		float expected_radius = 1.f; // 一个装满的 meshlet 的大致半径，用于把距离归一化
+
+		// 当前 meshlet
+		std::vector<uint32_t> vertices;
+		std::vector<uint8_t> triangles;
+		std::vector<int> triangle_ids; // 当前 meshlet 中的三角形在网格中的编号
+		Vec3f centroid_sum;
+		Vec3f normal_sum;
+
+		MeshletSet result;
+		std::vector<int> first_triangles; // 每个 meshlet 中编号最小的三角形
+
+		MeshletBuilder(const Mesh& mesh, int max_vertices, int max_triangles, float cone_weight)
+			: mesh(mesh), max_vertices(max_vertices), max_triangles(max_triangles), cone_weight(cone_weight),
+			offsets(mesh.vertex_count() + 1, 0), adjacency(mesh.indices.size()), live(mesh.vertex_count(), 0),
+			normals(mesh.triangle_count()), centroids(mesh.triangle_count()), emitted(mesh.triangle_count(), 0),
+			local(mesh.vertex_count(), -1) {
+			for (uint32_t v : mesh.indices) live[v]++;
+			std::partial_sum(live.begin(), live.end(), offsets.begin() + 1);
+			std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+			double area = 0;
+			for (int t = 0; t < mesh.triangle_count(); t++) {
+				const uint32_t* tri = &mesh.indices[3 * t];
+				for (int k = 0; k < 3; k++) adjacency[fill[tri[k]]++] = t;
+				const Vec3f& a = mesh.positions[tri[0]];
+				const Vec3f& b = mesh.positions[tri[1]];
+				const Vec3f& c = mesh.positions[tri[2]];
+				Vec3f n = (b - a) ^ (c - a);
+				const float length = n.norm();
+				area += 0.5 * length;
+				normals[t] = length > 0 ? n / length : Vec3f(0.f, 0.f, 0.f);
+				centroids[t] = (a + b + c) * (1.f / 3.f);
+			}
+			// 装满的 meshlet 近似一个圆盘，面积是平均三角形面积乘以三角形数
+			if (mesh.triangle_count() > 0 && area > 0) {
+				expected_radius = static_cast<float>(std::sqrt(area / mesh.triangle_count() * max_triangles / 3.14159265358979));
+			}
+		}
+
+		// 三角形不在当前 meshlet 中的顶点数
+		int extra_vertices(int t) const {
+			int extra = 0;
+			for (int k = 0; k < 3; k++) extra += local[mesh.indices[3 * t + k]] < 0;
+			return extra;
+		}
+
+		/**
+		 * @brief 在与当前 meshlet 的顶点相邻的三角形中选出下一个：新增顶点最少的优先，
+		 * 其次离 meshlet 的中心近、法向量接近平均法向量的优先。
+		 * @return 三角形编号，没有能加入的三角形时返回 -1。
+		 */
+		int next_triangle() const {
+			const float n = static_cast<float>(triangles.size() / 3);
+			const Vec3f center = centroid_sum / n;
+			Vec3f axis = normal_sum;
+			const float axis_length = axis.norm();
+			if (axis_length > 0) axis = axis / axis_length;
+
+			int best = -1, best_extra = 4;
+			float best_cost = 0;
+			for (uint32_t v : vertices) {
+				for (int j = offsets[v]; j < offsets[v] + live[v]; j++) {
+					const int t = adjacency[j];
+					int extra = extra_vertices(t);
+					if (static_cast<int>(vertices.size()) + extra > max_vertices) continue;
+					// 某个顶点只剩这一个三角形时，加入它可以让这个顶点不再出现在其它 meshlet 中，与不增加顶点同样优先
+					const uint32_t* tri = &mesh.indices[3 * t];
+					if (live[tri[0]] == 1 || live[tri[1]] == 1 || live[tri[2]] == 1) extra = 0;
+					if (extra > best_extra) continue;
+					const float distance = (centroids[t] - center).norm();
+					const float spread = normals[t] * axis;
+					const float cost = (1.f + distance / expected_radius * (1.f - cone_weight)) * std::max(1.f - spread * cone_weight, 1e-3f);
+					if (extra < best_extra || cost < best_cost) {
+						best = t;
+						best_extra = extra;
+						best_cost = cost;
+					}
+				}
+			}
+			return best;
+		}
+
+		void add_triangle(int t) {
+			for (int k = 0; k < 3; k++) {
+				const uint32_t v = mesh.indices[3 * t + k];
+				if (local[v] < 0) {
+					local[v] = static_cast<int>(vertices.size());
+					vertices.push_back(v);
+				}
+				triangles.push_back(static_cast<uint8_t>(local[v]));
+
+				// 从顶点的相邻三角形列表中移除，与最后一个交换
+				int* list = &adjacency[offsets[v]];
+				int* end = list + live[v];
+				*std::find(list, end, t) = end[-1];
+				live[v]--;
+			}
+			emitted[t] = 1;
+			triangle_ids.push_back(t);
+			centroid_sum = centroid_sum + centroids[t];
+			normal_sum = normal_sum + normals[t];
+		}
+
+		// 计算当前 meshlet 的包围球和法向量锥，写入结果并清空当前 meshlet
+		void finish_meshlet() {
+			if (triangles.empty()) return;
+			Meshlet m;
+			m.vertex_offset = static_cast<uint32_t>(result.vertices.size());
+			m.triangle_offset = static_cast<uint32_t>(result.triangles.size());
+			m.vertex_count = static_cast<uint32_t>(vertices.size());
+			m.triangle_count = static_cast<uint32_t>(triangles.size() / 3);
+
+			// 包围球：球心取包围盒的中心
+			Vec3f lo = mesh.positions[vertices[0]], hi = lo;
+			for (uint32_t v : vertices) {
+				const Vec3f& p = mesh.positions[v];
+				lo = Vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+				hi = Vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+			}
+			m.center = (lo + hi) * 0.5f;
+			float radius2 = 0;
+			for (uint32_t v : vertices) {
+				const Vec3f d = mesh.positions[v] - m.center;
+				radius2 = std::max(radius2, d * d);
+			}
+			m.radius = std::sqrt(radius2);
+
+			// 法向量锥：轴是单位法向量之和的方向，半顶角取最大的夹角；退化三角形在任何方向上都会被剔除，不参与
+			m.cone_axis = Vec3f(0.f, 0.f, 0.f);
+			m.cone_cos = -1.f;
+			const float axis_length = normal_sum.norm();
+			if (axis_length > 1e-6f) {
+				m.cone_axis = normal_sum / axis_length;
+				float min_dot = 1.f;
+				bool any = false;
+				for (size_t i = 0; i < triangles.size(); i += 3) {
+					const Vec3f& a = mesh.positions[vertices[triangles[i]]];
+					Vec3f n = (mesh.positions[vertices[triangles[i + 1]]] - a) ^ (mesh.positions[vertices[triangles[i + 2]]] - a);
+					const float length = n.norm();
+					if (!(length > 0)) continue;
+					min_dot = std::min(min_dot, (n * m.cone_axis) / length);
+					any = true;
+				}
+				if (any) m.cone_cos = std::max(min_dot, -1.f);
+			}
+			m.cone_sin = std::sqrt(std::max(0.f, 1.f - m.cone_cos * m.cone_cos));
+
+			// 三角形按在网格中的顺序排列，保留 optimize_mesh 排好的遮挡顺序
+			std::vector<int> order(triangle_ids.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&](int a, int b) { return triangle_ids[a] < triangle_ids[b]; });
+			result.meshlets.push_back(m);
+			result.vertices.insert(result.vertices.end(), vertices.begin(), vertices.end());
+			for (int i : order) {
+				result.triangles.insert(result.triangles.end(), &triangles[3 * i], &triangles[3 * i] + 3);
+			}
+			first_triangles.push_back(triangle_ids[order[0]]);
+			triangle_ids.clear();
+			for (uint32_t v : vertices) local[v] = -1;
+			vertices.clear();
+			triangles.clear();
+			centroid_sum = Vec3f(0.f, 0.f, 0.f);
+			normal_sum = Vec3f(0.f, 0.f, 0.f);
+		}
+
+		/**
+		 * @brief 新 meshlet 的第一个三角形：优先取与上一个 meshlet 相邻、还没有加入的三角形中最靠边的一个
+		 * （三个顶点剩下的相邻三角形最少），让相邻的区域连续地切分下去；没有时按索引顺序取下一个。
+		 */
+		int seed_triangle(const std::vector<uint32_t>& previous, int& cursor) const {
+			int best = -1, best_live = 0;
+			for (uint32_t v : previous) {
+				for (int j = offsets[v]; j < offsets[v] + live[v]; j++) {
+					const int t = adjacency[j];
+					const uint32_t* tri = &mesh.indices[3 * t];
+					const int valence = live[tri[0]] + live[tri[1]] + live[tri[2]];
+					if (best < 0 || valence < best_live) {
+						best = t;
+						best_live = valence;
+					}
+				}
+			}
+			if (best >= 0) return best;
+			while (emitted[cursor]) cursor++;
+			return cursor;
+		}
+
+		void build() {
+			const int triangle_count = mesh.triangle_count();
+			centroid_sum = Vec3f(0.f, 0.f, 0.f);
+			normal_sum = Vec3f(0.f, 0.f, 0.f);
+			std::vector<uint32_t> previous;
+			int cursor = 0;
+			for (int added = 0; added < triangle_count; added++) {
+				int t = triangles.empty() ? seed_triangle(previous, cursor) : next_triangle();
+				if (t < 0) {
+					// 当前 meshlet 周围没有能加入的三角形，开始一个新的 meshlet
+					previous = vertices;
+					finish_meshlet();
+					t = seed_triangle(previous, cursor);
+				}
+				add_triangle(t);
+				if (static_cast<int>(triangles.size() / 3) == max_triangles) {
+					previous = vertices;
+					finish_meshlet();
+				}
+			}
+			finish_meshlet();
+
+			// meshlet 也按各自第一个三角形在网格中的顺序排列
+			std::vector<int> order(result.meshlets.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&](int a, int b) { return first_triangles[a] < first_triangles[b]; });
+			MeshletSet sorted;
+			sorted.meshlets.reserve(result.meshlets.size());
+			sorted.vertices.reserve(result.vertices.size());
+			sorted.triangles.reserve(result.triangles.size());
+			for (int i : order) {
+				Meshlet m = result.meshlets[i];
+				const auto vertex_begin = result.vertices.begin() + m.vertex_offset;
+				const auto triangle_begin = result.triangles.begin() + m.triangle_offset;
+				m.vertex_offset = static_cast<uint32_t>(sorted.vertices.size());
+				m.triangle_offset = static_cast<uint32_t>(sorted.triangles.size());
+				sorted.vertices.insert(sorted.vertices.end(), vertex_begin, vertex_begin + m.vertex_count);
+				sorted.triangles.insert(sorted.triangles.end(), triangle_begin, triangle_begin + 3 * m.triangle_count);
+				sorted.meshlets.push_back(m);
+			}
+			result = std::move(sorted);
+		}
+	};
+
+} // namespace
+
+MeshletSet build_meshlets(const Mesh& mesh, int max_vertices, int max_triangles, float cone_weight) {
+	assert(max_vertices >= 3 && max_vertices <= 256 && max_triangles >= 1);
+	MeshletBuilder builder(mesh, max_vertices, max_triangles, std::min(std::max(cone_weight, 0.f), 1.f));
+	builder.build();
+	return std::move(builder.result);
+}
@@ -0,0 +1,68 @@
+/**
+
+@file meshlet.h
+@brief 把索引网格切分成 meshlet：每个 meshlet 是几十个相邻三角形组成的小块，自带局部顶点表、包围球和法向量锥。
+
+绘制时先用包围球做视锥剔除、用法向量锥做背面剔除，整块丢弃的 meshlet 不做任何顶点处理。
+切分时优先加入与已有顶点共享边的三角形，其次是离 meshlet 中心近、朝向与平均法向量接近的三角形，
+这样 meshlet 的包围球小、法向量锥窄，剔除才有效。
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "geometry.h"
+#include "mesh.h"
+
+/**
+
+@brief 一个 meshlet。局部顶点表是 MeshletSet::vertices[vertex_offset] ... [vertex_offset + vertex_count - 1]，
+第 i 个三角形的三个局部顶点编号是 MeshletSet::triangles[triangle_offset + 3i] ... [triangle_offset + 3i + 2]。
+*/
+struct Meshlet
+{
+	uint32_t vertex_offset;
+	uint32_t triangle_offset;
+	uint32_t vertex_count;
+	uint32_t triangle_count;
+	Vec3f center; // 包围球的球心（模型空间）
+	float radius; // 包围球的半径
+	Vec3f cone_axis; // 法向量锥的轴，是三角形单位法向量之和的方向
+	float cone_cos; // 法向量锥半顶角的余弦，所有非退化三角形的法向量与轴的夹角都不超过半顶角；不大于 0 时锥太宽，不能用于背面剔除
+	float cone_sin; // 法向量锥半顶角的正弦
+};
+
+/**
+
+@brief 一个网格的全部 meshlet，三角形的绕序与原网格相同。
+*/
+struct MeshletSet
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertices; // 各个 meshlet 的局部顶点表依次排列，元素是原网格中的顶点编号
+	std::vector<uint8_t> triangles; // 各个 meshlet 的三角形依次排列，每个三角形是三个局部顶点编号
+
+	bool empty() const { return meshlets.empty(); }
+
+	int meshlet_count() const { return static_cast<int>(meshlets.size()); }
+
+	/**
+	 * @brief 占用的字节数。
+	 */
+	size_t memory_bytes() const
+	{
+		return meshlets.size() * sizeof(Meshlet) + vertices.size() * sizeof(uint32_t) + triangles.size();
+	}
+};
+
+/**
+
+@brief 把网格的全部三角形切分成 meshlet。
+@param mesh 网格。
+@param max_vertices 每个 meshlet 最多的顶点数，不超过 256（局部顶点编号是 8 位的）。
+@param max_triangles 每个 meshlet 最多的三角形数。
+@param cone_weight 选择下一个三角形时朝向相对位置的权重，0 到 1 之间。越大法向量锥越窄，背面剔除越有效，但包围球会大一些。
+@return 切分结果。
+*/
+MeshletSet build_meshlets(const Mesh& mesh, int max_vertices = 64, int max_triangles = 124, float cone_weight = 0.5f);
@@ -6,6 +6,10 @@
 #include "tgaimage.h"
 #include "Texture.h"
 #include "Triangle.h"
+#include "mesh.h"
+#include "mesh_simplifier.h"
+#include "bvh.h"
+#include "meshlet.h"
 
 class Model {
 private:
@@ -14,15 +18,28 @@ private:
 	// 顶点数量和面片数量
 	int vertNum, faceNum;
 public:
-	//所有三角面片组成的数组
-	std::vector<Triangle> TriangleList;
+	//去重后的顶点属性和索引缓冲区
+	Mesh mesh;
+	//由 build_lods 生成的简化网格，从细到粗排列，不包含 mesh 本身
+	std::vector<MeshLod> lods;
+	//由 build_bvh 生成的三角形层次包围盒，用于拾取和阴影射线
+	Bvh bvh;
+	//由 build_meshlets 生成的 meshlet，meshlets[0] 对应 mesh，meshlets[i] 对应 lods[i - 1]
+	std::vector<MeshletSet> meshlets;
 
 	//根据.obj文件路径导入模型
 	Model(const char* filename);
 	// 析构函数，用于释放模型资源
 	~Model();
+	//build_* 修改模型本身，不是线程安全的；AssetRegistry 在加载时调用它们，交出的共享模型是只读的
+	//用二次误差度量简化 mesh，生成最多 max_levels 级 LOD，每一级的三角形数约为上一级的 reduction 倍
+	void build_lods(int max_levels = 6, float reduction = 0.5f);
+	//为 mesh 的三角形构建 BVH
+	void build_bvh();
+	//把 mesh 和已经生成的每一级 LOD 切分成 meshlet，应在 build_lods 之后调用
+	void build_meshlets();
 	//返回模型顶点数量
-	int nverts();
+	int nverts() const;
 	//返回模型面片数量
-	int nfaces();
+	int nfaces() const;
 };
\ No newline at end of file
@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <charconv>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "obj_loader.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+namespace {
+
+	constexpr int missing_index = std::numeric_limits<int>::min(); // 面顶点没有写纹理坐标或法向量
+
+	/**
+	 * @brief 面的一个顶点：位置、纹理坐标、法向量的索引（从 0 开始）。
+	 * 负数索引在解析时换算成相对本段开头的编号，relative 的第 k 位为 1 表示 index[k] 还要加上本段之前的数量。
+	 */
+	struct ObjCorner {
+		int index[3];
+		unsigned relative;
+	};
+
+	/**
+	 * @brief 一段 OBJ 文本的解析结果，面已经按扇形拆成三角形，每三个顶点一个三角形。
+	 */
+	struct ObjChunk {
+		std::vector<Vec3f> positions;
+		std::vector<Vec2f> tex_coords;
+		std::vector<Vec3f> normals;
+		std::vector<ObjCorner> corners;
+		int faces = 0;
+		const char* error_at = nullptr; // 第一个错误的位置，没有错误时为 nullptr
+		const char* error = nullptr; // 错误原因
+	};
+
+	/**
+	 * @brief 按行扫描 OBJ 文本。所有函数都不会越过 end。
+	 */
+	struct ObjScanner {
+		const char* p;
+		const char* end;
+
+		static bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+		void skip_blanks() {
+			while (p < end && is_blank(*p)) p++;
+		}
+
+		void skip_line() {
+			const void* nl = std::memchr(p, '\n', end - p);
+			p = nl ? static_cast<const char*>(nl) + 1 : end;
+		}
+
+		// 跳过空白后是否到了行尾（注释也算行尾）
+		bool at_line_end() {
+			skip_blanks();
+			return p == end || *p == '\n' || *p == '#';
+		}
+
+		// 当前位置是否是关键字 keyword 且后面紧跟空白
+		bool keyword(const char* word, int length) {
+			if (end - p <= length || std::memcmp(p, word, length) != 0 || !is_blank(p[length])) return false;
+			p += length;
+			return true;
+		}
+
+		bool parse_float(float& value) {
+			skip_blanks();
+			if (p < end && *p == '+') p++;
+			auto result = std::from_chars(p, end, value);
+			if (result.ec == std::errc::result_out_of_range) {
+				// 超出 float 范围的数按 strtof 的规则取无穷大或 0
+				char buffer[64];
+				size_t n = std::min<size_t>(result.ptr - p, sizeof(buffer) - 1);
+				std::memcpy(buffer, p, n);
+				buffer[n] = '\0';
+				value = std::strtof(buffer, nullptr);
+			}
+			else if (result.ec != std::errc()) {
+				return false;
+			}
+			p = result.ptr;
+			return true;
+		}
+
+		bool parse_int(int& value) {
+			bool negative = false;
+			if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+			if (p == end || *p < '0' || *p > '9') return false;
+			long long v = 0;
+			while (p < end && *p >= '0' && *p <= '9') {
+				v = v * 10 + (*p++ - '0');
+				if (v > std::numeric_limits<int>::max()) return false;
+			}
+			value = static_cast<int>(negative ? -v : v);
+			return true;
+		}
+
+		// 解析一个从 1 开始的索引，负数相对当前已读取的 count 个元素
+		bool parse_index(int count, int& index, unsigned& relative, unsigned bit) {
+			int raw;
+			if (!parse_int(raw) || raw == 0) return false;
+			if (raw > 0) {
+				index = raw - 1;
+			}
+			else {
+				index = count + raw;
+				relative |= bit;
+			}
+			return true;
+		}
+	};
+
+	static bool fail(ObjChunk& chunk, const char* at, const char* reason) {
+		chunk.error_at = at;
+		chunk.error = reason;
+		return false;
+	}
+
+	/**
+	 * @brief 解析 [begin, end) 中的 OBJ 文本，begin 必须是一行的开头。
+	 */
+	static bool parse_obj(const char* begin, const char* end, ObjChunk& chunk) {
+		ObjScanner s{ begin, end };
+		while (s.p < end) {
+			s.skip_blanks();
+			const char* line = s.p;
+			if (s.keyword("v", 1)) {
+				Vec3f v;
+				if (!s.parse_float(v.x) || !s.parse_float(v.y) || !s.parse_float(v.z)) return fail(chunk, line, "bad vertex");
+				chunk.positions.push_back(v);
+			}
+			else if (s.keyword("vt", 2)) {
+				Vec2f uv;
+				if (!s.parse_float(uv.x)) return fail(chunk, line, "bad texture coordinate");
+				if (!s.at_line_end() && !s.parse_float(uv.y)) return fail(chunk, line, "bad texture coordinate");
+				chunk.tex_coords.push_back(uv);
+			}
+			else if (s.keyword("vn", 2)) {
+				Vec3f n;
+				if (!s.parse_float(n.x) || !s.parse_float(n.y) || !s.parse_float(n.z)) return fail(chunk, line, "bad normal");
+				chunk.normals.push_back(n);
+			}
+			else if (s.keyword("f", 1)) {
+				const int counts[3] = {
+					static_cast<int>(chunk.positions.size()),
+					static_cast<int>(chunk.tex_coords.size()),
+					static_cast<int>(chunk.normals.size())
+				};
+				ObjCorner first{}, prev{};
+				int n = 0;
+				while (!s.at_line_end()) {
+					// v、v/vt、v//vn 或 v/vt/vn
+					ObjCorner c = { { missing_index, missing_index, missing_index }, 0 };
+					if (!s.parse_index(counts[0], c.index[0], c.relative, 1)) return fail(chunk, line, "bad face");
+					if (s.p < end && *s.p == '/') {
+						s.p++;
+						if (s.p < end && *s.p != '/' && !s.parse_index(counts[1], c.index[1], c.relative, 2)) return fail(chunk, line, "bad face");
+						if (s.p < end && *s.p == '/') {
+							s.p++;
+							if (!s.parse_index(counts[2], c.index[2], c.relative, 4)) return fail(chunk, line, "bad face");
+						}
+					}
+					if (s.p < end && !ObjScanner::is_blank(*s.p) && *s.p != '\n' && *s.p != '#') return fail(chunk, line, "bad face");
+					// 多边形按扇形拆成三角形
+					if (n == 0) first = c;
+					if (n >= 2) {
+						chunk.corners.push_back(first);
+						chunk.corners.push_back(prev);
+						chunk.corners.push_back(c);
+					}
+					prev = c;
+					n++;
+				}
+				if (n < 3) return fail(chunk, line, "face with fewer than 3 vertices");
+				chunk.faces++;
+			}
+			// 其他语句、注释、多余的分量（v 的 w、顶点颜色等）都跳过
+			s.skip_line();
+		}
+		return true;
+	}
+
+	/**
+	 * @brief 把各段的解析结果合并成索引网格。
+	 *
+	 * 先按各段元素数量的前缀和得到每段在合并数组中的起始位置，然后并行地拷贝顶点属性、修正相对索引并检查索引范围，
+	 * 最后按文件顺序对面顶点去重，得到的网格与整个文件作为一段解析时完全相同。
+	 */
+	static bool build_mesh(std::vector<ObjChunk>& chunks, Mesh& mesh, ThreadPool* pool) {
+		const int chunk_count = static_cast<int>(chunks.size());
+		auto for_each_chunk = [&](const std::function<void(int)>& task) {
+			if (pool) pool->parallel_for(chunk_count, task);
+			else for (int i = 0; i < chunk_count; i++) task(i);
+		};
+
+		// offset[i][k] 是第 i 段的第 k 种属性（位置、纹理坐标、法向量）在合并数组中的起始位置
+		std::vector<std::array<int, 3>> offset(chunk_count + 1);
+		std::vector<size_t> corner_offset(chunk_count + 1);
+		offset[0] = { 0, 0, 0 };
+		corner_offset[0] = 0;
+		for (int i = 0; i < chunk_count; i++) {
+			offset[i + 1][0] = offset[i][0] + static_cast<int>(chunks[i].positions.size());
+			offset[i + 1][1] = offset[i][1] + static_cast<int>(chunks[i].tex_coords.size());
+			offset[i + 1][2] = offset[i][2] + static_cast<int>(chunks[i].normals.size());
+			corner_offset[i + 1] = corner_offset[i] + chunks[i].corners.size();
+		}
+
+		std::vector<Vec3f> positions(offset[chunk_count][0]);
+		std::vector<Vec2f> tex_coords(offset[chunk_count][1]);
+		std::vector<Vec3f> normals(offset[chunk_count][2]);
+		std::vector<ObjCorner> corners(corner_offset[chunk_count]);
+		std::atomic<bool> out_of_range{ false };
+		for_each_chunk([&](int i) {
+			ObjChunk& c = chunks[i];
+			std::copy(c.positions.begin(), c.positions.end(), positions.begin() + offset[i][0]);
+			std::copy(c.tex_coords.begin(), c.tex_coords.end(), tex_coords.begin() + offset[i][1]);
+			std::copy(c.normals.begin(), c.normals.end(), normals.begin() + offset[i][2]);
+			// 正索引是绝对编号，负索引已在解析时换算成本段内的编号、这里加上本段的起始位置。
+			// 和逐行读取的加载器一样，面可以引用文件中任何位置定义的元素，所以按整个文件的总数检查，结果与分段方式和线程数无关
+			ObjCorner* out = corners.data() + corner_offset[i];
+			for (const ObjCorner& corner : c.corners) {
+				ObjCorner fixed = { { corner.index[0], corner.index[1], corner.index[2] }, 0 };
+				for (int k = 0; k < 3; k++) {
+					if (fixed.index[k] == missing_index) continue;
+					if (corner.relative & (1u << k)) fixed.index[k] += offset[i][k];
+					if (fixed.index[k] < 0 || fixed.index[k] >= offset[chunk_count][k]) out_of_range = true;
+				}
+				*out++ = fixed;
+			}
+			c = ObjChunk();
+		});
+		if (out_of_range) {
+			std::cerr << "obj: face index out of range" << std::endl;
+			mesh = Mesh();
+			return false;
+		}
+
+		// 同一位置的面顶点串成链表，按 (vt, vn) 查找已有的网格顶点
+		struct Node {
+			int tex_coord, normal;
+			uint32_t vertex;
+			int next;
+		};
+		std::vector<int> head(positions.size(), -1);
+		std::vector<Node> nodes;
+		std::vector<char> needs_normal;
+
+		mesh = Mesh();
+		mesh.indices.reserve(corners.size());
+		for (const ObjCorner& corner : corners) {
+			const int* index = corner.index;
+			int node = head[index[0]];
+			while (node >= 0 && (nodes[node].tex_coord != index[1] || nodes[node].normal != index[2])) {
+				node = nodes[node].next;
+			}
+			if (node < 0) {
+				node = static_cast<int>(nodes.size());
+				nodes.push_back({ index[1], index[2], static_cast<uint32_t>(mesh.positions.size()), head[index[0]] });
+				head[index[0]] = node;
+				mesh.positions.push_back(positions[index[0]]);
+				mesh.tex_coords.push_back(index[1] == missing_index ? Vec2f(0.f, 0.f) : tex_coords[index[1]]);
+				mesh.normals.push_back(index[2] == missing_index ? Vec3f(0.f, 0.f, 0.f) : normals[index[2]]);
+				needs_normal.push_back(index[2] == missing_index);
+			}
+			mesh.indices.push_back(nodes[node].vertex);
+		}
+
+		// 缺少法向量的顶点累加相邻三角形的面法向量（叉积的长度是面积的两倍，即按面积加权）
+		bool any_missing = false;
+		for (char m : needs_normal) any_missing |= m != 0;
+		if (any_missing) {
+			for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+				const uint32_t* tri = &mesh.indices[t];
+				Vec3f n = (mesh.positions[tri[1]] - mesh.positions[tri[0]]) ^ (mesh.positions[tri[2]] - mesh.positions[tri[0]]);
+				for (int k = 0; k < 3; k++) {
+					if (needs_normal[tri[k]]) mesh.normals[tri[k]] = mesh.normals[tri[k]] + n;
+				}
+			}
+			for (size_t i = 0; i < needs_normal.size(); i++) {
+				if (needs_normal[i] && mesh.normals[i].norm() > 0) mesh.normals[i].normalize();
+			}
+		}
+		mesh.compute_bounds();
+		return true;
+	}
+
+	static int line_number(const char* begin, const char* at) {
+		int line = 1;
+		for (const char* p = begin; p < at; p++) line += *p == '\n';
+		return line;
+	}
+
+} // namespace
+
+bool load_obj(const char* filename, Mesh& mesh, ObjLoadInfo* info, int thread_count) {
+	auto start = std::chrono::steady_clock::now();
+	mesh = Mesh();
+
+	MappedFile file(filename);
+	if (!file.is_open()) {
+		std::cerr << "obj: cannot open " << filename << std::endl;
+		return false;
+	}
+	const char* begin = file.data();
+	const char* end = begin + file.size();
+
+	// 文件按行边界切成若干段，每段至少 min_chunk_bytes 字节，由线程池并行解析
+	const size_t min_chunk_bytes = 1 << 20;
+	if (thread_count <= 0) thread_count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	const int chunk_count = static_cast<int>(std::min<size_t>(std::max<size_t>(file.size() / min_chunk_bytes, 1), static_cast<size_t>(thread_count) * 4));
+	std::vector<const char*> bounds(chunk_count + 1);
+	bounds[0] = begin;
+	bounds[chunk_count] = end;
+	for (int i = 1; i < chunk_count; i++) {
+		const char* p = std::max(bounds[i - 1], begin + file.size() / chunk_count * i);
+		const void* nl = std::memchr(p, '\n', end - p);
+		bounds[i] = nl ? static_cast<const char*>(nl) + 1 : end;
+	}
+
+	std::unique_ptr<ThreadPool> pool;
+	if (chunk_count > 1 && thread_count > 1) pool = std::make_unique<ThreadPool>(thread_count);
+	std::vector<ObjChunk> chunks(chunk_count);
+	auto parse_chunk = [&](int i) { parse_obj(bounds[i], bounds[i + 1], chunks[i]); };
+	if (pool) pool->parallel_for(chunk_count, parse_chunk);
+	else for (int i = 0; i < chunk_count; i++) parse_chunk(i);
+
+	for (const ObjChunk& c : chunks) {
+		if (c.error_at) {
+			std::cerr << "obj: " << filename << ":" << line_number(begin, c.error_at) << ": " << c.error << std::endl;
+			return false;
+		}
+	}
+
+	ObjLoadInfo result;
+	for (const ObjChunk& c : chunks) {
+		result.positions += static_cast<int>(c.positions.size());
+		result.tex_coords += static_cast<int>(c.tex_coords.size());
+		result.normals += static_cast<int>(c.normals.size());
+		result.faces += c.faces;
+	}
+	if (!build_mesh(chunks, mesh, pool.get())) return false;
+
+	result.bytes = file.size();
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (info) *info = result;
+	return true;
+}
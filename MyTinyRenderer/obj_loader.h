@@ -0,0 +1,47 @@
+/**
+
+@file obj_loader.h
+@brief Wavefront OBJ 读取：内存映射整个文件，按行边界分段后由线程池并行解析，用手写的扫描器和 std::from_chars 解析数字，
+合并后直接生成索引网格。
+*/
+#pragma once
+
+#include <cstddef>
+
+#include "mesh.h"
+
+/**
+
+@brief 一次 OBJ 读取的统计信息。
+*/
+struct ObjLoadInfo
+{
+	int positions = 0; // 文件中 v 的行数
+	int tex_coords = 0; // 文件中 vt 的行数
+	int normals = 0; // 文件中 vn 的行数
+	int faces = 0; // 文件中 f 的行数，多边形按扇形拆成三角形前的数量
+	size_t bytes = 0; // 文件大小（字节）
+	double seconds = 0; // 从映射文件到生成网格的总耗时（秒）
+
+	/**
+	 * @brief 解析吞吐量（MB/s）。
+	 */
+	double megabytes_per_second() const { return seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0; }
+};
+
+/**
+
+@brief 读取 OBJ 文件并生成索引网格。
+
+支持 v、vt、vn 和 f，面的顶点可以写成 v、v/vt、v//vn 或 v/vt/vn，索引可以是负数（相对当前已读取的数量）。
+多于三个顶点的面按扇形拆成三角形。其他语句（o、g、s、usemtl 等）和注释会被跳过。
+位置、纹理坐标、法向量索引都相同的面顶点在网格中只存一份；缺少纹理坐标的顶点取 (0, 0)，
+缺少法向量的顶点使用相邻三角形按面积加权的平均法向量。
+
+@param filename 文件路径。
+@param mesh 输出的网格，原有内容会被清空。
+@param info 输出的统计信息，可以为 nullptr。
+@param thread_count 解析所用的线程数，小于等于 0 时使用硬件并发数。小文件只分一段，不创建线程。
+@return 成功返回 true；文件无法打开或格式错误时在标准错误流中打印原因并返回 false，此时 mesh 为空。
+*/
+bool load_obj(const char* filename, Mesh& mesh, ObjLoadInfo* info = nullptr, int thread_count = 0);
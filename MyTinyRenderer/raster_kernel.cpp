@@ -0,0 +1,288 @@
+#include <algorithm>
+
+#include "raster_kernel.h"
+#include "simd_target.h"
+
+namespace rst {
+
+	/*
+	 * 所有实现都按同样的顺序计算：
+	 *   w_k   = base[k] + offset[k][lane]
+	 *   bary  = w_k * inv_area
+	 *   z     = (bary0 * z0 + bary1 * z1) + bary2 * z2
+	 *   mask  = (w0 >= 0 && w1 >= 0 && w2 >= 0 && z > depth) & lane_mask
+	 * test_coverage 为 false 时省略边函数的符号测试，test_depth 为 false 时省略深度测试。
+	 * 没有使用 FMA，保证不同指令集下结果逐位一致。
+	 */
+
+	static unsigned block_kernel_scalar(const BlockInput& in, BlockOutput& out) {
+		unsigned mask = 0;
+		for (int l = 0; l < block_lanes; l++) {
+			float w0 = in.base[0] + in.offset[l];
+			float w1 = in.base[1] + in.offset[block_lanes + l];
+			float w2 = in.base[2] + in.offset[2 * block_lanes + l];
+			float alpha = w0 * in.inv_area;
+			float beta = w1 * in.inv_area;
+			float gamma = w2 * in.inv_area;
+			float z = alpha * in.z[0] + beta * in.z[1] + gamma * in.z[2];
+			out.bary[0][l] = alpha;
+			out.bary[1][l] = beta;
+			out.bary[2][l] = gamma;
+			out.z[l] = z;
+			bool inside = !in.test_coverage || (w0 >= 0 && w1 >= 0 && w2 >= 0);
+			bool closer = !in.test_depth || z > in.depth[l];
+			if (inside && closer) {
+				mask |= 1u << l;
+			}
+		}
+		return mask & in.lane_mask;
+	}
+
+	/*
+	 * 解析内核中每个像素的每个分量都按同样的顺序计算：
+	 *   acc = 0
+	 *   对每个 (dy, dx)、每个采样点 k：acc = acc + weight * sample
+	 *   out = acc * scale
+	 * SIMD 实现把相邻像素放在不同 lane 中，每个 lane 的运算序列与标量实现相同。
+	 */
+
+	static void resolve_pixel(const ResolveInput& in, int i) {
+		const int span = 2 * in.radius + 1;
+		const int n = in.sample_count;
+		float acc[3] = { 0.f, 0.f, 0.f };
+		for (int dy = 0; dy < span; dy++) {
+			for (int dx = 0; dx < span; dx++) {
+				const int x = std::min(std::max(i + dx - in.radius, 0), in.width - 1);
+				const float* samples = in.rows[dy] + 3 * n * x;
+				const float* weights = in.weights + (dy * span + dx) * n;
+				for (int k = 0; k < n; k++) {
+					acc[0] += weights[k] * samples[3 * k];
+					acc[1] += weights[k] * samples[3 * k + 1];
+					acc[2] += weights[k] * samples[3 * k + 2];
+				}
+			}
+		}
+		in.out[3 * i] = acc[0] * in.scale;
+		in.out[3 * i + 1] = acc[1] * in.scale;
+		in.out[3 * i + 2] = acc[2] * in.scale;
+	}
+
+	static void resolve_kernel_scalar(const ResolveInput& in) {
+		for (int i = 0; i < in.width; i++) {
+			resolve_pixel(in, i);
+		}
+	}
+
+#ifdef RST_X86
+	static unsigned block_kernel_sse2(const BlockInput& in, BlockOutput& out) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 all_ones = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		const __m128 inv_area = _mm_set1_ps(in.inv_area);
+		unsigned mask = 0;
+		// 8 个 lane 分成两半，每半 4 个
+		for (int h = 0; h < block_lanes; h += 4) {
+			__m128 w0 = _mm_add_ps(_mm_set1_ps(in.base[0]), _mm_loadu_ps(in.offset + h));
+			__m128 w1 = _mm_add_ps(_mm_set1_ps(in.base[1]), _mm_loadu_ps(in.offset + block_lanes + h));
+			__m128 w2 = _mm_add_ps(_mm_set1_ps(in.base[2]), _mm_loadu_ps(in.offset + 2 * block_lanes + h));
+			__m128 alpha = _mm_mul_ps(w0, inv_area);
+			__m128 beta = _mm_mul_ps(w1, inv_area);
+			__m128 gamma = _mm_mul_ps(w2, inv_area);
+			__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(alpha, _mm_set1_ps(in.z[0])), _mm_mul_ps(beta, _mm_set1_ps(in.z[1]))),
+				_mm_mul_ps(gamma, _mm_set1_ps(in.z[2])));
+			_mm_store_ps(out.bary[0] + h, alpha);
+			_mm_store_ps(out.bary[1] + h, beta);
+			_mm_store_ps(out.bary[2] + h, gamma);
+			_mm_store_ps(out.z + h, z);
+
+			__m128 inside = in.test_coverage
+				? _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero))
+				: all_ones;
+			__m128 closer = in.test_depth ? _mm_cmpgt_ps(z, _mm_loadu_ps(in.depth + h)) : all_ones;
+			__m128 pass = _mm_and_ps(inside, closer);
+			mask |= static_cast<unsigned>(_mm_movemask_ps(pass)) << h;
+		}
+		return mask & in.lane_mask;
+	}
+
+	/*
+	 * SIMD 解析按 lanes 个像素一组处理一行的中间部分：
+	 * - 每个采样点的 r、g、b 用一次 4 个 float 的读取取出，第 4 个 float 属于后面的采样点或像素；
+	 *   lanes 个像素的读取结果转置后得到 r、g、b 各一个寄存器。
+	 * - 结果转置回每个像素 4 个 float 依次写出，最后一次多写的 1 个 float 是下一组的第一个像素，随后会被覆盖。
+	 * 组内像素及其邻域都不越过行的左右边缘，多读、多写的那个像素也在同一行中，所以中间部分要求
+	 * i - radius >= 0 且 i + lanes + radius < width；边缘的像素由 resolve_pixel 按最近的像素延伸，最后处理。
+	 */
+
+	static void resolve_kernel_sse2(const ResolveInput& in) {
+		const int lanes = 4;
+		const int span = 2 * in.radius + 1;
+		const int n = in.sample_count;
+		const size_t stride = 3 * static_cast<size_t>(n); // 相邻像素之间的 float 数
+		const __m128 scale = _mm_set1_ps(in.scale);
+		int i = 0;
+		for (; i < in.radius; i++) resolve_pixel(in, i);
+		for (; i + lanes + in.radius < in.width; i += lanes) {
+			__m128 r = _mm_setzero_ps(), g = _mm_setzero_ps(), b = _mm_setzero_ps();
+			for (int dy = 0; dy < span; dy++) {
+				for (int dx = 0; dx < span; dx++) {
+					const float* samples = in.rows[dy] + stride * (i + dx - in.radius);
+					const float* weights = in.weights + (dy * span + dx) * n;
+					for (int k = 0; k < n; k++) {
+						const float* s = samples + 3 * k;
+						__m128 p0 = _mm_loadu_ps(s);
+						__m128 p1 = _mm_loadu_ps(s + stride);
+						__m128 p2 = _mm_loadu_ps(s + 2 * stride);
+						__m128 p3 = _mm_loadu_ps(s + 3 * stride);
+						_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+						const __m128 w = _mm_set1_ps(weights[k]);
+						r = _mm_add_ps(r, _mm_mul_ps(w, p0));
+						g = _mm_add_ps(g, _mm_mul_ps(w, p1));
+						b = _mm_add_ps(b, _mm_mul_ps(w, p2));
+					}
+				}
+			}
+			r = _mm_mul_ps(r, scale);
+			g = _mm_mul_ps(g, scale);
+			b = _mm_mul_ps(b, scale);
+			__m128 a = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+			float* out = in.out + 3 * i;
+			_mm_storeu_ps(out, r);
+			_mm_storeu_ps(out + 3, g);
+			_mm_storeu_ps(out + 6, b);
+			_mm_storeu_ps(out + 9, a);
+		}
+		for (; i < in.width; i++) resolve_pixel(in, i);
+	}
+
+	RST_TARGET_AVX
+	static void resolve_kernel_avx(const ResolveInput& in) {
+		const int lanes = 8;
+		const int span = 2 * in.radius + 1;
+		const int n = in.sample_count;
+		const size_t stride = 3 * static_cast<size_t>(n);
+		const __m256 scale = _mm256_set1_ps(in.scale);
+		const __m256 zero = _mm256_setzero_ps();
+		int i = 0;
+		for (; i < in.radius; i++) resolve_pixel(in, i);
+		for (; i + lanes + in.radius < in.width; i += lanes) {
+			__m256 r = zero, g = zero, b = zero;
+			for (int dy = 0; dy < span; dy++) {
+				for (int dx = 0; dx < span; dx++) {
+					const float* samples = in.rows[dy] + stride * (i + dx - in.radius);
+					const float* weights = in.weights + (dy * span + dx) * n;
+					for (int k = 0; k < n; k++) {
+						// 像素 j 和 j + 4 放在同一个寄存器的低、高两半，两半分别做 4x4 转置
+						const float* s = samples + 3 * k;
+						__m256 p[4];
+						for (int j = 0; j < 4; j++) {
+							p[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(s + j * stride)), _mm_loadu_ps(s + (j + 4) * stride), 1);
+						}
+						const __m256 t0 = _mm256_unpacklo_ps(p[0], p[1]);
+						const __m256 t1 = _mm256_unpackhi_ps(p[0], p[1]);
+						const __m256 t2 = _mm256_unpacklo_ps(p[2], p[3]);
+						const __m256 t3 = _mm256_unpackhi_ps(p[2], p[3]);
+						const __m256 w = _mm256_set1_ps(weights[k]);
+						r = _mm256_add_ps(r, _mm256_mul_ps(w, _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0))));
+						g = _mm256_add_ps(g, _mm256_mul_ps(w, _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2))));
+						b = _mm256_add_ps(b, _mm256_mul_ps(w, _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0))));
+					}
+				}
+			}
+			r = _mm256_mul_ps(r, scale);
+			g = _mm256_mul_ps(g, scale);
+			b = _mm256_mul_ps(b, scale);
+			const __m256 rg_lo = _mm256_unpacklo_ps(r, g);
+			const __m256 rg_hi = _mm256_unpackhi_ps(r, g);
+			const __m256 b_lo = _mm256_unpacklo_ps(b, zero);
+			const __m256 b_hi = _mm256_unpackhi_ps(b, zero);
+			const __m256 q[4] = {
+				_mm256_shuffle_ps(rg_lo, b_lo, _MM_SHUFFLE(1, 0, 1, 0)),
+				_mm256_shuffle_ps(rg_lo, b_lo, _MM_SHUFFLE(3, 2, 3, 2)),
+				_mm256_shuffle_ps(rg_hi, b_hi, _MM_SHUFFLE(1, 0, 1, 0)),
+				_mm256_shuffle_ps(rg_hi, b_hi, _MM_SHUFFLE(3, 2, 3, 2)),
+			};
+			float* out = in.out + 3 * i;
+			for (int j = 0; j < 4; j++) {
+				_mm_storeu_ps(out + 3 * j, _mm256_castps256_ps128(q[j]));
+			}
+			for (int j = 0; j < 4; j++) {
+				_mm_storeu_ps(out + 3 * (j + 4), _mm256_extractf128_ps(q[j], 1));
+			}
+		}
+		for (; i < in.width; i++) resolve_pixel(in, i);
+	}
+
+	RST_TARGET_AVX
+	static unsigned block_kernel_avx(const BlockInput& in, BlockOutput& out) {
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 inv_area = _mm256_set1_ps(in.inv_area);
+		__m256 w0 = _mm256_add_ps(_mm256_set1_ps(in.base[0]), _mm256_loadu_ps(in.offset));
+		__m256 w1 = _mm256_add_ps(_mm256_set1_ps(in.base[1]), _mm256_loadu_ps(in.offset + block_lanes));
+		__m256 w2 = _mm256_add_ps(_mm256_set1_ps(in.base[2]), _mm256_loadu_ps(in.offset + 2 * block_lanes));
+		__m256 alpha = _mm256_mul_ps(w0, inv_area);
+		__m256 beta = _mm256_mul_ps(w1, inv_area);
+		__m256 gamma = _mm256_mul_ps(w2, inv_area);
+		__m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(alpha, _mm256_set1_ps(in.z[0])), _mm256_mul_ps(beta, _mm256_set1_ps(in.z[1]))),
+			_mm256_mul_ps(gamma, _mm256_set1_ps(in.z[2])));
+		_mm256_store_ps(out.bary[0], alpha);
+		_mm256_store_ps(out.bary[1], beta);
+		_mm256_store_ps(out.bary[2], gamma);
+		_mm256_store_ps(out.z, z);
+
+		__m256 pass = in.test_depth ? _mm256_cmp_ps(z, _mm256_loadu_ps(in.depth), _CMP_GT_OQ) : _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		if (in.test_coverage) {
+			__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(w0, zero, _CMP_GE_OQ), _mm256_cmp_ps(w1, zero, _CMP_GE_OQ)),
+				_mm256_cmp_ps(w2, zero, _CMP_GE_OQ));
+			pass = _mm256_and_ps(inside, pass);
+		}
+		return static_cast<unsigned>(_mm256_movemask_ps(pass)) & in.lane_mask;
+	}
+#endif
+
+	SimdLevel detect_simd_level() {
+#if defined(RST_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		// 操作系统还必须在上下文切换时保存 YMM 寄存器
+		if (avx && osxsave && (_xgetbv(0) & 0x6) == 0x6) return SimdLevel::AVX;
+		if (sse2) return SimdLevel::SSE2;
+		return SimdLevel::Scalar;
+#elif defined(RST_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx")) return SimdLevel::AVX;
+		if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+		return SimdLevel::Scalar;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	const char* simd_level_name(SimdLevel level) {
+		switch (level) {
+		case SimdLevel::AVX: return "AVX";
+		case SimdLevel::SSE2: return "SSE2";
+		default: return "Scalar";
+		}
+	}
+
+	BlockKernel select_block_kernel(SimdLevel level) {
+#ifdef RST_X86
+		if (level == SimdLevel::AVX) return block_kernel_avx;
+		if (level == SimdLevel::SSE2) return block_kernel_sse2;
+#endif
+		return block_kernel_scalar;
+	}
+
+	ResolveKernel select_resolve_kernel(SimdLevel level) {
+#ifdef RST_X86
+		if (level == SimdLevel::AVX) return resolve_kernel_avx;
+		if (level == SimdLevel::SSE2) return resolve_kernel_sse2;
+#endif
+		return resolve_kernel_scalar;
+	}
+
+} // namespace rst
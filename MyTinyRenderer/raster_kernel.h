@@ -0,0 +1,111 @@
+/**
+
+@file raster_kernel.h
+@brief 光栅化内循环的批量内核：一次完成 8 个采样点的边函数、深度插值和深度测试，并在运行时按 CPU 特性选择 AVX/SSE2/标量实现。
+另外还有超采样解析用的加权求和内核。
+*/
+#pragma once
+
+namespace rst {
+
+	/**
+
+	@brief 一次批量处理的采样点数（lane 数）。非 MSAA 时是一行中连续的 8 个像素，MSAA 时是一个像素内的 8 个采样点。
+	*/
+	constexpr int block_lanes = 8;
+
+	/**
+
+	@brief 批量内核可用的指令集级别，从低到高排列。
+	*/
+	enum class SimdLevel
+	{
+		Scalar,
+		SSE2,
+		AVX
+	};
+
+	/**
+
+	@brief 批量内核的输入。
+	*/
+	struct BlockInput
+	{
+		float base[3]; // 块起点处三条边函数的值
+		const float* offset; // 每个 lane 相对块起点的边函数增量，按 offset[k * block_lanes + lane] 排列
+		float inv_area; // 三角形面积的倒数，用于把边函数换算成重心坐标
+		float z[3]; // 三个顶点的屏幕空间深度
+		const float* depth; // 深度缓冲区中对应的 block_lanes 个深度值
+		unsigned lane_mask; // 有效 lane 的位掩码，块不满 8 个或部分 lane 落在区域外时对应位为 0
+		bool test_coverage; // 为 false 时表示整个块已确定在三角形内部，跳过边函数的符号测试，只做深度测试
+		bool test_depth; // 为 false 时表示分层深度已确定整个块都比深度缓冲区更近，跳过深度测试（depth 不会被读取）
+	};
+
+	/**
+
+	@brief 批量内核的输出，只有覆盖掩码中置位的 lane 是有意义的。
+	*/
+	struct BlockOutput
+	{
+		alignas(32) float bary[3][block_lanes]; // 每个 lane 的重心坐标 alpha、beta、gamma
+		alignas(32) float z[block_lanes]; // 每个 lane 插值得到的深度
+	};
+
+	/**
+
+	@brief 批量内核函数类型。
+	@return 覆盖掩码：第 l 位为 1 表示 lane l 在三角形内部（含边界，或 test_coverage 为 false）
+	且通过了深度测试（比深度缓冲区中的值更大，或 test_depth 为 false）。
+	*/
+	using BlockKernel = unsigned (*)(const BlockInput& in, BlockOutput& out);
+
+	/**
+
+	@brief 解析内核的输入：帧缓冲区中的一整行。滤波器覆盖 (2 * radius + 1) x (2 * radius + 1) 个像素，
+	每个像素的 sample_count 个颜色采样点（各 3 个 float：r、g、b）连续存放。
+	*/
+	struct ResolveInput
+	{
+		const float* rows[3]; // 滤波器覆盖的 2 * radius + 1 行超采样颜色，从上一行到下一行，屏幕边缘已按最近的行延伸
+		const float* weights; // 权重，按 (dy, dx, 采样点) 的顺序排列，共 (2 * radius + 1)² * sample_count 个
+		int radius; // 滤波器半径（像素），0 或 1；左右边缘按最近的像素延伸
+		int width; // 一行的像素数
+		int sample_count; // 每个像素的采样点数
+		float scale; // 加权和最后乘以的系数
+		float* out; // 输出的一行颜色，共 3 * width 个 float
+	};
+
+	/**
+
+	@brief 解析内核函数类型：对一行中的每个像素，按 (dy, dx, 采样点) 的顺序把 weights[k] * 采样点颜色累加到 0 上，再乘以 scale。
+	所有实现对每个像素的计算顺序都相同，SIMD 实现只是同时计算相邻的几个像素，结果与标量实现逐位一致。
+	*/
+	using ResolveKernel = void (*)(const ResolveInput& in);
+
+	/**
+
+	@brief 检测当前 CPU 和操作系统支持的最高指令集级别。
+	*/
+	SimdLevel detect_simd_level();
+
+	/**
+
+	@brief 返回指令集级别的名字，用于日志输出。
+	*/
+	const char* simd_level_name(SimdLevel level);
+
+	/**
+
+	@brief 返回指定级别的批量内核。所有实现的计算顺序相同，结果逐位一致。
+	@param level 指令集级别，超出当前编译目标支持范围时退化为标量实现。
+	*/
+	BlockKernel select_block_kernel(SimdLevel level);
+
+	/**
+
+	@brief 返回指定级别的解析内核。SSE2 实现一次解析 4 个像素，AVX 实现一次解析 8 个像素。
+	@param level 指令集级别，超出当前编译目标支持范围时退化为标量实现。
+	*/
+	ResolveKernel select_resolve_kernel(SimdLevel level);
+
+} // namespace rst
@@ -1,7 +1,141 @@
 #include <algorithm>
+#include <cmath>
 #include "rasterizer.h"
 #include <iostream>
 
+rst::rasterizer::rasterizer(int w, int h, int sample_count, int thread_count, SamplePattern pattern) : width(w), height(h), sample_pattern(pattern) {
+    // 采样点数只支持 1、2、4、8、16，其它值退化为不超过它的最大受支持值
+    int supported = max_samples;
+    while (supported > 1 && supported > sample_count) supported /= 2;
+    if (supported != sample_count) {
+        std::cerr << "unsupported sample count " << sample_count << ", using " << supported << "\n";
+    }
+    this->sample_count = supported;
+    sample_positions = sample_points(pattern, supported);
+
+    frame_buffer.resize(w * h);
+    depth_buffer.resize(w * h);
+    super_frame_buffer.resize(w * h * supported);
+    super_depth_buffer.resize(w * h * supported);
+    texture = nullptr;
+
+    // 按 tile_size 把屏幕划分成分块，最右和最上一列分块可能不满
+    for (int y = 0; y < h; y += tile_size) {
+        for (int x = 0; x < w; x += tile_size) {
+            Tile tile;
+            tile.rect = { x, y, std::min(x + tile_size, w) - 1, std::min(y + tile_size, h) - 1 };
+            tiles.push_back(tile);
+        }
+    }
+    tiles_x = (w + tile_size - 1) / tile_size;
+
+    // 分层深度：每个像素块和每个分块各记录一个深度范围
+    blocks_x = (w + block_size - 1) / block_size;
+    const int blocks = blocks_x * ((h + block_size - 1) / block_size);
+    for (auto* hz : { &hiz, &super_hiz }) {
+        hz->block_min.resize(blocks);
+        hz->block_max.resize(blocks);
+        hz->tile_min.resize(tiles.size());
+        hz->tile_max.resize(tiles.size());
+        hz->reset();
+    }
+
+    pool = std::make_unique<ThreadPool>(thread_count);
+
+    // 按 CPU 特性选择光栅化批量内核
+    set_simd_level(detect_simd_level());
+}
+
+void rst::rasterizer::set_simd_level(SimdLevel level) {
+    simd_level = level;
+    block_kernel = select_block_kernel(level);
+    resolve_kernel = select_resolve_kernel(level);
+    vertex_kernel = select_vertex_kernel(level);
+}
+
+void rst::rasterizer::set_antialiasing(AntiAliasing mode) {
+    antialiasing = mode;
+}
+
+void rst::rasterizer::set_cull_mode(CullMode mode) {
+    cull_mode = mode;
+}
+
+void rst::rasterizer::set_front_face(FrontFace face) {
+    front_face = face;
+}
+
+void rst::rasterizer::set_lod_threshold(float pixels) {
+    lod_threshold = pixels;
+}
+
+int rst::rasterizer::select_lod(const Mesh& mesh, const std::vector<MeshLod>& lods) {
+    if (lods.empty()) return 0;
+    // 视口与 draw_primitives 相同，NDC 中的单位长度在 x、y 方向上分别是 w / 2 和 h / 2 个像素
+    const float w = width * 3.f / 4.f;
+    const float h = height * 3.f / 4.f;
+    Mat4f mvp = projectionMatrix * viewMartix * modelMartix;
+    // 矩阵第 i 行前三列的长度：模型空间中移动单位长度时，裁剪空间的第 i 个分量最多变化多少
+    auto row_length = [&](int i) { return Vec3f(mvp[i][0], mvp[i][1], mvp[i][2]).norm(); };
+
+    Vec4f center((mesh.bounds_min.x + mesh.bounds_max.x) * 0.5f, (mesh.bounds_min.y + mesh.bounds_max.y) * 0.5f,
+        (mesh.bounds_min.z + mesh.bounds_max.z) * 0.5f, 1.f);
+    const float radius = (mesh.bounds_max - mesh.bounds_min).norm() * 0.5f;
+    const Vec4f c = mvp * center;
+    const float w_min = c.w - radius * row_length(3);
+    if (!(w_min > near_w)) return 0;
+
+    // x / w 的变化率是 (dx - x / w * dw) / w，分母取外接球上最小的 w
+    const float sx = (row_length(0) + std::abs(c.x / c.w) * row_length(3)) / w_min * (w / 2.f);
+    const float sy = (row_length(1) + std::abs(c.y / c.w) * row_length(3)) / w_min * (h / 2.f);
+    const float pixels_per_unit = std::max(sx, sy);
+
+    int level = 0;
+    while (level < static_cast<int>(lods.size()) && lods[level].error * pixels_per_unit <= lod_threshold) level++;
+    return level;
+}
+
+Ray rst::rasterizer::screen_ray(float x, float y) {
+    // 视口变换的逆变换，与 draw_primitives 中的 ndc_x、ndc_y 相同
+    const float w = width * 3.f / 4.f;
+    const float h = height * 3.f / 4.f;
+    const float ndc_x = (x - w / 2.f - width / 8.f) / (w / 2.f);
+    const float ndc_y = (y - h / 2.f - height / 8.f) / (h / 2.f);
+    Mat4f mvp = projectionMatrix * viewMartix * modelMartix;
+
+    // 投影到这一点的模型空间坐标 X 满足 (row0 - ndc_x * row3)·X = 0 和 (row1 - ndc_y * row3)·X = 0，
+    // 两个平面的交线就是射线所在的直线
+    const Vec4f a = mvp[0] - mvp[3] * ndc_x;
+    const Vec4f b = mvp[1] - mvp[3] * ndc_y;
+    const Vec3f na(a.x, a.y, a.z), nb(b.x, b.y, b.z);
+    Vec3f dir = na ^ nb;
+    const float length2 = dir * dir;
+    Ray ray;
+    if (!(length2 > 0)) return ray;
+    // 平面 n·X = d 的交线上的一点：(d_a (n_b × dir) + d_b (dir × n_a)) / |dir|²
+    const Vec3f point = ((nb ^ dir) * -a.w + (dir ^ na) * -b.w) / length2;
+    dir.normalize();
+
+    const Vec3f row3(mvp[3].x, mvp[3].y, mvp[3].z);
+    const float dw = row3 * dir;
+    if (std::abs(dw) > 1e-6f * row3.norm()) {
+        // 透视投影：沿射线 w 增大的方向远离相机，起点放在 w = near_w 的近平面上
+        if (dw < 0) dir = dir * -1.f;
+        const float w0 = row3 * point + mvp[3].w;
+        ray.origin = point + dir * ((near_w - w0) / std::abs(dw));
+        ray.direction = dir;
+    }
+    else {
+        // 没有透视时沿视线方向（视图空间的 -z）
+        Mat4f mv = viewMartix * modelMartix;
+        if (Vec3f(mv[2].x, mv[2].y, mv[2].z) * dir > 0) dir = dir * -1.f;
+        ray.origin = point;
+        ray.direction = dir;
+        ray.t_min = -std::numeric_limits<float>::max();
+    }
+    return ray;
+}
+
 void rst::rasterizer::set_model(const Mat4f& m) {
 	modelMartix = m;
 }
@@ -14,8 +148,9 @@ void rst::rasterizer::set_projection(const Mat4f& p) {
 	projectionMatrix = p;
 }
 
-void rst::rasterizer::set_texture(Texture tex) {
-	texture = tex;
+void rst::rasterizer::set_texture(std::shared_ptr<const Texture> tex, const Sampler& tex_sampler) {
+	texture = std::move(tex);
+	sampler = tex_sampler;
 }
 
 void rst::rasterizer::clear(Buffers buf) {
@@ -32,6 +167,9 @@ void rst::rasterizer::clear(Buffers buf) {
         // 如果要清空超采样深度缓冲区，将超采样深度缓冲区的所有像素深度设置为负无穷大（-∞）。
         // 这样做是为了确保在渲染场景时所有像素都可以被覆盖，因为深度测试会使用超采样深度缓冲区的值来判断像素是否被覆盖。
         std::fill(super_depth_buffer.begin(), super_depth_buffer.end(), -std::numeric_limits<float>::infinity());
+        // 分层深度与深度缓冲区保持一致
+        hiz.reset();
+        super_hiz.reset();
     }
 }
 
@@ -72,122 +210,772 @@ std::vector<Vec2f> rst::rasterizer::getSuperSampleStep(int sampl_count) {
     return steps;
 }
 
-void rst::rasterizer::draw(std::vector<Triangle>& TriangleList) {
+/**
+ * @brief 齐次裁剪空间中的裁剪平面，点 p 到平面的有向距离为 x * p.x + y * p.y + w * p.w + c，非负表示在内侧
+ */
+struct ClipPlane {
+    float x, y, w, c;
+
+    float distance(const Vec4f& p) const { return x * p.x + y * p.y + w * p.w + c; }
+};
+
+/**
+ * @brief 裁剪阶段的顶点：裁剪空间坐标和需要随之插值的全部顶点属性
+ */
+struct ClipVertex {
+    Vec4f pos;
+    Vec3f view_pos;
+    Vec3f normal;
+    Vec2f tex_coords;
+    Vec3f color;
+};
+
+/**
+ * @brief 一个凸多边形裁剪一个平面后最多增加一个顶点，三角形依次裁剪近平面和四个保护带平面后最多有 8 个顶点
+ */
+constexpr int max_clip_vertices = 3 + 5;
+
+/**
+ * @brief 用 Sutherland-Hodgman 算法把凸多边形裁剪到平面内侧
+ *
+ * 裁剪空间到视图空间是仿射变换，所以在裁剪空间中按距离比例线性插值得到的属性就是交点处的属性。
+ *
+ * @param in 输入多边形的顶点
+ * @param count 输入顶点数
+ * @param plane 裁剪平面
+ * @param out 输出多边形的顶点，至少能容纳 count + 1 个顶点
+ * @return 输出顶点数，小于3时说明多边形完全在平面外侧
+ */
+static int clipPolygon(const ClipVertex* in, int count, const ClipPlane& plane, ClipVertex* out) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        const ClipVertex& a = in[i];
+        const ClipVertex& b = in[(i + 1) % count];
+        float da = plane.distance(a.pos);
+        float db = plane.distance(b.pos);
+        if (da >= 0) out[n++] = a;
+        if ((da >= 0) != (db >= 0)) {
+            // 边 ab 与平面相交，插入交点
+            float s = da / (da - db);
+            out[n].pos = a.pos + (b.pos - a.pos) * s;
+            out[n].view_pos = a.view_pos + (b.view_pos - a.view_pos) * s;
+            out[n].normal = a.normal + (b.normal - a.normal) * s;
+            out[n].tex_coords = a.tex_coords + (b.tex_coords - a.tex_coords) * s;
+            out[n].color = a.color + (b.color - a.color) * s;
+            n++;
+        }
+    }
+    return n;
+}
+
+void rst::rasterizer::draw(std::vector<Triangle>& TriangleList, ShadingMode mode) {
+    // 独立三角形没有共享顶点，顶点流中第 i 个三角形的三个顶点依次是 3i、3i+1、3i+2
+    const int triangle_count = static_cast<int>(TriangleList.size());
+    vertices.resize(3 * triangle_count);
+    for (int i = 0; i < triangle_count; i++) {
+        for (int k = 0; k < 3; k++) {
+            vertices.set_position(3 * i + k, TriangleList[i].v[k]);
+        }
+    }
+    draw_primitives(triangle_count, [&](int i, Triangle& tri, int index[3]) {
+        tri = TriangleList[i];
+        for (int k = 0; k < 3; k++) {
+            index[k] = 3 * i + k;
+        }
+    }, mode);
+}
+
+void rst::rasterizer::draw(const Mesh& mesh, ShadingMode mode) {
+    // 顶点流就是去重后的顶点，每个顶点只变换一次，三角形通过索引读取变换结果
+    vertices.resize(mesh.vertex_count());
+    for (int i = 0; i < mesh.vertex_count(); i++) {
+        const Vec3f& p = mesh.positions[i];
+        vertices.set_position(i, Vec4f(p.x, p.y, p.z, 1.f));
+    }
+    draw_primitives(mesh.triangle_count(), [&](int i, Triangle& tri, int index[3]) {
+        for (int k = 0; k < 3; k++) {
+            const uint32_t vi = mesh.indices[3 * i + k];
+            index[k] = static_cast<int>(vi);
+            tri.normal[k] = mesh.normals[vi];
+            tri.texCoords[k] = mesh.tex_coords[vi];
+            tri.color[k] = Vec3f(0.f, 0.f, 0.f);
+        }
+    }, mode);
+}
+
+void rst::rasterizer::draw(const Mesh& mesh, const std::vector<MeshLod>& lods, ShadingMode mode) {
+    const int level = select_lod(mesh, lods);
+    draw(level == 0 ? mesh : lods[level - 1].mesh, mode);
+}
+
+void rst::rasterizer::draw(const Mesh& mesh, const MeshletSet& meshlets, ShadingMode mode) {
+    if (meshlets.empty()) {
+        draw(mesh, mode);
+        return;
+    }
+    // 视口与 draw_primitives 相同
+    const float w = width * 3.f / 4.f;
+    const float h = height * 3.f / 4.f;
+    auto ndc_x = [&](float X) { return (X - w / 2.f - width / 8.f) / (w / 2.f); };
+    auto ndc_y = [&](float Y) { return (Y - h / 2.f - height / 8.f) / (h / 2.f); };
+    Mat4f mvp = projectionMatrix * viewMartix * modelMartix;
+    const Vec4f row0 = mvp[0], row1 = mvp[1], row3 = mvp[3];
+
+    // draw_primitives 中的近平面和四条屏幕边界。裁剪空间中的平面 a x + b y + c w + d >= 0
+    // 在模型空间中是 (a row0 + b row1 + c row3 + (0, 0, 0, d))·(X, 1) >= 0
+    const Vec4f planes[5] = {
+        row3 - Vec4f(0.f, 0.f, 0.f, near_w),
+        row0 - row3 * ndc_x(0.f), row3 * ndc_x((float)width) - row0,
+        row1 - row3 * ndc_y(0.f), row3 * ndc_y((float)height) - row1
+    };
+    float plane_scale[5];
+    for (int k = 0; k < 5; k++) {
+        plane_scale[k] = Vec3f(planes[k].x, planes[k].y, planes[k].z).norm();
+    }
+
+    // 投影中心的齐次坐标 E 是 MVP 第 0、1、3 行的广义叉积（E·X = det[row0; row1; row3; X]）。
+    // 模型空间中法向量为 n（逆时针绕序的叉积）、经过点 p 的三角形，在屏幕上的有向面积与 n·E.xyz - E.w (n·p) 反号
+    auto det3 = [](const Vec3f& a, const Vec3f& b, const Vec3f& c) { return a * (b ^ c); };
+    const Vec3f a0(row0.y, row0.z, row0.w), a1(row1.y, row1.z, row1.w), a3(row3.y, row3.z, row3.w);
+    const Vec3f b0(row0.x, row0.z, row0.w), b1(row1.x, row1.z, row1.w), b3(row3.x, row3.z, row3.w);
+    const Vec3f c0(row0.x, row0.y, row0.w), c1(row1.x, row1.y, row1.w), c3(row3.x, row3.y, row3.w);
+    const Vec3f d0(row0.x, row0.y, row0.z), d1(row1.x, row1.y, row1.z), d3(row3.x, row3.y, row3.z);
+    const Vec3f eye_xyz(-det3(a0, a1, a3), det3(b0, b1, b3), -det3(c0, c1, c3));
+    const float eye_w = det3(d0, d1, d3);
+    // 要剔除的三角形满足 side * (n·E.xyz - E.w (n·p)) > 0，即有向面积为负（side = 1）或为正（side = -1）
+    const bool cone_culling = cull_mode != CullMode::None;
+    const float side = (cull_mode == CullMode::Back) == (front_face == FrontFace::CounterClockwise) ? 1.f : -1.f;
+    const bool perspective = std::abs(eye_w) > 1e-6f * eye_xyz.norm();
+    const Vec3f eye = perspective ? eye_xyz / eye_w : Vec3f(0.f, 0.f, 0.f);
+
+    // 法向量锥中所有的法向量 n 和包围球中所有的点 p 都满足剔除条件时，整个 meshlet 都会被剔除
+    auto cone_culled = [&](const Meshlet& m) {
+        if (!(m.cone_cos > 0)) return false;
+        if (!perspective) {
+            // 没有透视时条件与 p 无关：n·(side E.xyz) > 0，锥轴与 side E.xyz 的夹角加半顶角不到 90 度即可
+            const Vec3f d = eye_xyz * side;
+            return m.cone_axis * d > m.cone_sin * d.norm();
+        }
+        // 透视时条件是 n·(p - eye) 与 side * E.w 反号，取 axis 为按这个符号翻转后的锥轴。
+        // 锥轴与球心方向的夹角、锥的半顶角、包围球对投影中心的半张角三者之和不到 90 度时，条件对锥和球内的所有组合成立
+        const Vec3f axis = m.cone_axis * (side * eye_w > 0 ? -1.f : 1.f);
+        const Vec3f to_center = m.center - eye;
+        const float distance = to_center.norm();
+        if (!(distance > m.radius)) return false;
+        const float sin_d = m.radius / distance;
+        const float cos_d = std::sqrt(1.f - sin_d * sin_d);
+        // cos(α + δ) > 0 且 cos(夹角) > sin(α + δ)
+        if (m.cone_cos * cos_d - m.cone_sin * sin_d <= 0) return false;
+        return axis * to_center > (m.cone_sin * cos_d + m.cone_cos * sin_d) * distance;
+    };
+
+    CullStats meshlet_stats;
+    meshlet_stats.meshlets = meshlets.meshlet_count();
+    meshlet_vertices.clear();
+    meshlet_indices.clear();
+    for (const Meshlet& m : meshlets.meshlets) {
+        const Vec4f center(m.center.x, m.center.y, m.center.z, 1.f);
+        bool outside = false;
+        for (int k = 0; k < 5 && !outside; k++) {
+            outside = planes[k] * center < -m.radius * plane_scale[k];
+        }
+        if (outside) {
+            meshlet_stats.meshlet_frustum++;
+            meshlet_stats.frustum += m.triangle_count;
+            continue;
+        }
+        if (cone_culling && cone_culled(m)) {
+            meshlet_stats.meshlet_backface++;
+            meshlet_stats.backface += m.triangle_count;
+            continue;
+        }
+        // 局部顶点表接到顶点流末尾，局部编号加上起点就是顶点流中的编号
+        const int base = static_cast<int>(meshlet_vertices.size());
+        meshlet_vertices.insert(meshlet_vertices.end(), meshlets.vertices.begin() + m.vertex_offset,
+            meshlets.vertices.begin() + m.vertex_offset + m.vertex_count);
+        const uint8_t* local = &meshlets.triangles[m.triangle_offset];
+        for (uint32_t i = 0; i < 3 * m.triangle_count; i++) {
+            meshlet_indices.push_back(base + local[i]);
+        }
+    }
+
+    // 只有未被剔除的 meshlet 的顶点进入顶点流
+    vertices.resize(static_cast<int>(meshlet_vertices.size()));
+    for (int i = 0; i < static_cast<int>(meshlet_vertices.size()); i++) {
+        const Vec3f& p = mesh.positions[meshlet_vertices[i]];
+        vertices.set_position(i, Vec4f(p.x, p.y, p.z, 1.f));
+    }
+    draw_primitives(static_cast<int>(meshlet_indices.size() / 3), [&](int i, Triangle& tri, int index[3]) {
+        for (int k = 0; k < 3; k++) {
+            index[k] = meshlet_indices[3 * i + k];
+            const uint32_t vi = meshlet_vertices[index[k]];
+            tri.normal[k] = mesh.normals[vi];
+            tri.texCoords[k] = mesh.tex_coords[vi];
+            tri.color[k] = Vec3f(0.f, 0.f, 0.f);
+        }
+    }, mode);
+
+    // draw_primitives 只统计了送进来的三角形，加上整块剔除的部分
+    cull_stats.input += meshlet_stats.frustum + meshlet_stats.backface;
+    cull_stats.frustum += meshlet_stats.frustum;
+    cull_stats.backface += meshlet_stats.backface;
+    cull_stats.meshlets = meshlet_stats.meshlets;
+    cull_stats.meshlet_frustum = meshlet_stats.meshlet_frustum;
+    cull_stats.meshlet_backface = meshlet_stats.meshlet_backface;
+}
+
+void rst::rasterizer::draw(const Mesh& mesh, const std::vector<MeshLod>& lods, const std::vector<MeshletSet>& meshlets, ShadingMode mode) {
+    const int level = select_lod(mesh, lods);
+    const Mesh& selected = level == 0 ? mesh : lods[level - 1].mesh;
+    if (level < static_cast<int>(meshlets.size())) {
+        draw(selected, meshlets[level], mode);
+    }
+    else {
+        draw(selected, mode);
+    }
+}
+
+template <class Assemble>
+void rst::rasterizer::draw_primitives(int triangle_count, Assemble&& assemble, ShadingMode mode) {
     // 这里其实是(f-n)/2    (f+n)/2,将n设为0，f设为255
     float f1 = (255 - .0) / 2.;
     float f2 = (255 + .0) / 2.;
 
-    // 计算MVP矩阵
+    // 屏幕宽度
+    float w = width * 3.f / 4.f;
+    // 屏幕高度
+    float h = height * 3.f / 4.f;
+    // 屏幕左下角,x_offset 和 y_offset 是微调因子，用于微调物体在屏幕上的位置。将它们分别加到 x_pixel 和 y_pixel 上，得到物体在屏幕上的实际位置。
+    float x_offset = width / 8.f;
+    float y_offset = height / 8.f;
+
+    // 透视除法和视口变换，把裁剪空间的顶点坐标转换到屏幕空间
+    auto to_screen = [&](Vec4f& vec) {
+        // 进行透视除法，将每个顶点坐标归一化，即将其除以其对应的w分量，将坐标转化到标准化设备坐标系(NDC)
+        vec.x = vec.x / vec.w;
+        vec.y = vec.y / vec.w;
+        vec.z = vec.z / vec.w;
+
+        // 视口变换，将每个顶点坐标从NDC空间转换到屏幕空间
+        vec.x = w / 2.f * vec.x + w / 2.f + x_offset;
+        vec.y = h / 2.f * vec.y + h / 2.f + y_offset;
+        vec.z = vec.z * f1 + f2;
+    };
+
+    // 裁剪平面：屏幕坐标 X 对应的 NDC 坐标是 (X - w / 2 - x_offset) / (w / 2)，乘以 w 分量后就是裁剪空间中的平面。
+    // 0 号是近平面，1~4 号是保护带的左右下上边界，5~8 号是屏幕的左右下上边界
+    auto ndc_x = [&](float X) { return (X - w / 2.f - x_offset) / (w / 2.f); };
+    auto ndc_y = [&](float Y) { return (Y - h / 2.f - y_offset) / (h / 2.f); };
+    const ClipPlane planes[9] = {
+        { 0.f, 0.f, 1.f, -near_w },
+        { 1.f, 0.f, -ndc_x(-guard_band), 0.f }, { -1.f, 0.f, ndc_x(width + guard_band), 0.f },
+        { 0.f, 1.f, -ndc_y(-guard_band), 0.f }, { 0.f, -1.f, ndc_y(height + guard_band), 0.f },
+        { 1.f, 0.f, -ndc_x(0.f), 0.f }, { -1.f, 0.f, ndc_x((float)width), 0.f },
+        { 0.f, 1.f, -ndc_y(0.f), 0.f }, { 0.f, -1.f, ndc_y((float)height), 0.f }
+    };
+    const unsigned guard_mask = 0x1f; // 近平面和保护带
+    const unsigned visible_mask = 0x1e1; // 近平面和屏幕边界
+
+    // 每次绘制只计算一次 MV 和 MVP 矩阵
+    Mat4f mv = viewMartix * modelMartix;
     Mat4f mvp = projectionMatrix * viewMartix * modelMartix;
 
-    // 遍历三角形列表
-    for (auto& t : TriangleList) {
-        // 初始化深度值和新三角形
-        int depth = 255;// 认为n = 0.0f, f = 255.0f
-        Triangle newtri = t;
+    // 顶点处理阶段：顶点流中的全部顶点分批完成 MVP 变换、透视除法和视口变换，
+    // 后面的裁剪和提交直接读取变换结果。视口变换与 to_screen 相同：x、y 是 (ndc * w / 2 + w / 2) + offset，z 是 ndc * f1 + f2
+    const VertexTransform xf = make_vertex_transform(mv, mvp,
+        Vec3f(w / 2.f, h / 2.f, f1), Vec3f(w / 2.f, h / 2.f, f2), Vec3f(x_offset, y_offset, 0.f));
+    vertex_kernel(xf, vertices, vertices.padded_size());
+
+    // 每个顶点在哪些裁剪平面的外侧也只计算一次，和变换结果一起作为变换后的顶点缓存
+    vertex_outcodes.resize(vertices.padded_size());
+    for (int i = 0; i < vertices.padded_size(); i++) {
+        const Vec4f p = vertices.clip_position(i);
+        unsigned code = 0;
+        for (int k = 0; k < 9; k++) {
+            if (planes[k].distance(p) < 0) code |= 1u << k;
+        }
+        vertex_outcodes[i] = code;
+    }
+
+    screen_triangles.clear();
+    view_positions.clear();
+    cull_stats = CullStats();
+    cull_stats.input = triangle_count;
+
+    // 遍历三角形完成裁剪和剔除，结果先保存下来，等分块完成后再并行光栅化
+    Triangle t;
+    for (int i = 0; i < triangle_count; i++) {
+        // 组装三角形的顶点属性，并取出三个顶点在顶点流中的编号
+        int index[3];
+        assemble(i, t, index);
+
+        // 裁剪空间坐标、视图空间坐标和每个顶点在哪些裁剪平面的外侧
+        Vec4f v[3];
+        std::array<Vec3f, 3> viewspace_pos;
+        unsigned outcode[3];
+        for (int k = 0; k < 3; k++) {
+            v[k] = vertices.clip_position(index[k]);
+            viewspace_pos[k] = vertices.view_position(index[k]);
+            outcode[k] = vertex_outcodes[index[k]];
+        }
+        // 三个顶点都在近平面后面或同一条屏幕边界外侧时，整个三角形不可见，不进入后面的分块和光栅化
+        if (outcode[0] & outcode[1] & outcode[2] & visible_mask) {
+            cull_stats.frustum++;
+            continue;
+        }
+
+        // 提交一个已经变换到屏幕空间的三角形
+        auto submit = [&](Triangle& tri, const std::array<Vec3f, 3>& view_pos) {
+            // 剔除背面、退化和不覆盖任何采样点的三角形
+            if (cull_triangle(tri)) return;
 
-        std::vector<Vec4f> mm {
-            (viewMartix * modelMartix * t.v[0]),
-            (viewMartix * modelMartix * t.v[1]),
-            (viewMartix * modelMartix * t.v[2])
+            //tri.computeFColor({ 1,0,0 });
+            //tri.computeGColor({ 1,0,0 });
+            //tri.setFlatNormal();
+            tri.setColor(0, 148, 121.0, 92.0);
+            tri.setColor(1, 148, 121.0, 92.0);
+            tri.setColor(2, 148, 121.0, 92.0);
+
+            screen_triangles.push_back(tri);
+            view_positions.push_back(view_pos);
+            cull_stats.rasterized++;
         };
 
-        std::vector<Vec3f> viewspace_pos;
+        // 所有顶点都在近平面前面且在保护带内时不需要裁剪，超出屏幕的部分由包围盒裁剪处理
+        unsigned crossed = (outcode[0] | outcode[1] | outcode[2]) & guard_mask;
+        if (crossed == 0) {
+            for (int k = 0; k < 3; k++) {
+                t.v[k] = vertices.screen_position(index[k]);
+            }
+            submit(t, viewspace_pos);
+            continue;
+        }
 
-        for (const Vec4f& v : mm) {
-            viewspace_pos.push_back(Vec3f(v.x, v.y, v.z));
+        // 只对顶点实际越过的平面做齐次裁剪，得到的凸多边形按扇形拆成三角形，绕序不变
+        cull_stats.clipped++;
+        ClipVertex poly[2][max_clip_vertices + 1];
+        int count = 3, cur = 0;
+        for (int k = 0; k < 3; k++) {
+            poly[0][k] = { v[k], viewspace_pos[k], t.normal[k], t.texCoords[k], t.color[k] };
+        }
+        for (int p = 0; p < 5 && count >= 3; p++) {
+            if (!(crossed & (1u << p))) continue;
+            count = clipPolygon(poly[cur], count, planes[p], poly[1 - cur]);
+            cur = 1 - cur;
         }
+        if (count < 3) {
+            // 与保护带或近平面相交的部分只是一条边或一个点
+            cull_stats.frustum++;
+            continue;
+        }
+        for (int k = 1; k + 1 < count; k++) {
+            const ClipVertex* fan[3] = { &poly[cur][0], &poly[cur][k], &poly[cur][k + 1] };
+            Triangle clipped = t;
+            std::array<Vec3f, 3> clipped_view_pos;
+            for (int j = 0; j < 3; j++) {
+                // 裁剪产生的新顶点不在顶点流中，单独做透视除法和视口变换
+                clipped.v[j] = fan[j]->pos;
+                to_screen(clipped.v[j]);
+                clipped.normal[j] = fan[j]->normal;
+                clipped.texCoords[j] = fan[j]->tex_coords;
+                clipped.color[j] = fan[j]->color;
+                clipped_view_pos[j] = fan[j]->view_pos;
+            }
+            submit(clipped, clipped_view_pos);
+        }
+    }
 
+    // 把三角形分配到屏幕分块中
+    bin_triangles();
 
-        // 计算经过MVP变换的点，将三角形的顶点转化为Vec4f类型，并存储在数组v中
-        Vec4f v[3];
-        for (int i = 0; i < 3; i++)
-        {
-            v[i] = t.v[i];
+    // 延迟着色需要可见性缓冲区，按超采样缓冲区的大小分配，足够两种光栅化方式使用；
+    // 解析阶段会把用过的采样点重置为未写入，所以只在第一次分配时初始化
+    shading_mode = mode;
+    if (shading_mode == ShadingMode::Deferred && visibility_buffer.size() < super_depth_buffer.size()) {
+        visibility_buffer.assign(std::max(super_depth_buffer.size(), depth_buffer.size()), VisibilitySample());
+    }
+
+    // 每个分块由一个线程独占光栅化，分块之间没有共享的像素，所以写缓冲区时不需要加锁
+    pool->parallel_for(static_cast<int>(tiles.size()), [this](int tile_index) {
+        Tile& tile = tiles[tile_index];
+        for (int idx : tile.triangles) {
+            // 光栅化新三角形，生成最终的图像
+            //rasterizer_triangle(screen_triangles[idx], tile.rect);
+            //rasterizer_triangle_msaa(screen_triangles[idx], tile.rect);
+            //rasterizer_triangle_new(screen_triangles[idx], view_positions[idx], idx, tile.rect);
+            rasterizer_triangle_msaa_new(screen_triangles[idx], view_positions[idx], idx, tile.rect);
         }
-        // 将顶点坐标乘以MVP矩阵，得到CVV裁剪空间
-        for (auto& vec : v) {
-            Vec4f tmp;
-            tmp = mvp * vec;
-            vec.x = tmp[0];
-            vec.y = tmp[1];
-            vec.z = tmp[2];
-            vec.w = tmp[3];
+    });
+
+    // 所有三角形都光栅化完成后，可见性缓冲区中就是最终可见的三角形，此时再统一着色
+    if (shading_mode == ShadingMode::Deferred) {
+        //resolve_visibility(false);
+        resolve_visibility(true);
+    }
+}
+
+bool rst::rasterizer::cull_triangle(const Triangle& t) {
+    const Vec4f* pts = t.v;
+
+    // 屏幕空间有向面积的两倍，y 轴向上，逆时针为正
+    float area = (pts[1].x - pts[0].x) * (pts[2].y - pts[0].y) - (pts[2].x - pts[0].x) * (pts[1].y - pts[0].y);
+    if (!std::isfinite(area) || area == 0.f) {
+        cull_stats.degenerate++;
+        return true;
+    }
+
+    if (cull_mode != CullMode::None) {
+        bool front = (area > 0) == (front_face == FrontFace::CounterClockwise);
+        if (front == (cull_mode == CullMode::Front)) {
+            cull_stats.backface++;
+            return true;
         }
+    }
 
-        // 进行透视除法，将每个顶点坐标归一化，即将其除以其对应的w分量，将坐标转化到标准化设备坐标系(NDC)
-        for (auto& vec : v)
-        {
-            vec.x = vec.x / vec.w;
-            vec.y = vec.y / vec.w;
-            vec.z = vec.z / vec.w;
+    // 小三角形：包围盒不到一个像素宽或高时，检查包围盒里是否有像素中心或采样点。
+    // 采样点 (i + s.x, j + s.y) 落在 [minx, maxx] 内当且仅当 ceil(minx - s.x) <= floor(maxx - s.x)，y 方向同理
+    float minx = std::min({ pts[0].x, pts[1].x, pts[2].x });
+    float maxx = std::max({ pts[0].x, pts[1].x, pts[2].x });
+    float miny = std::min({ pts[0].y, pts[1].y, pts[2].y });
+    float maxy = std::max({ pts[0].y, pts[1].y, pts[2].y });
+    if (maxx - minx < 1.f || maxy - miny < 1.f) {
+        auto contains = [&](float sx, float sy) {
+            return std::ceil(minx - sx) <= std::floor(maxx - sx) && std::ceil(miny - sy) <= std::floor(maxy - sy);
+        };
+        bool hit = contains(0.5f, 0.5f);
+        for (int k = 0; k < sample_count && !hit; k++) {
+            hit = contains(sample_positions[k].x, sample_positions[k].y);
+        }
+        if (!hit) {
+            cull_stats.micro++;
+            return true;
         }
+    }
+    return false;
+}
 
-        // 视口变换，将每个顶点坐标从NDC空间转换到屏幕空间
-        for (auto& vec : v)
-        {
-            // 屏幕宽度
-            float w = width * 3.f / 4.f;
-            // 屏幕高度
-            float h = height * 3.f / 4.f;
-            // 屏幕左下角,x_offset 和 y_offset 是微调因子，用于微调物体在屏幕上的位置。将它们分别加到 x_pixel 和 y_pixel 上，得到物体在屏幕上的实际位置。
-            float x_offset = width / 8.f;
-            float y_offset = height / 8.f;
+Vec3f rst::rasterizer::shade_fragment(const Triangle& t, const std::array<Vec3f, 3>& view_pos, float alpha, float beta, float gamma) {
+    Vec2f uv_interpolation = t.texCoords[0] * alpha + t.texCoords[1] * beta + t.texCoords[2] * gamma;
+    Vec3f color_interpolation = t.color[0] * alpha + t.color[1] * beta + t.color[2] * gamma;
+    Vec3f normal_interpolation = t.normal[0] * alpha + t.normal[1] * beta + t.normal[2] * gamma;
+    Vec3f shadingcoords_interpolated = view_pos[0] * alpha + view_pos[1] * beta + view_pos[2] * gamma;
+
+    fragment_shader_payload payload(color_interpolation, normal_interpolation, uv_interpolation, texture.get(), t.flatNormal);
+    payload.view_pos = shadingcoords_interpolated;
+    payload.sampler = sampler;
+
+    // 重心坐标在屏幕空间中是线性的，对 x、y 的偏导数在整个三角形上不变，纹理坐标的导数由它们加权得到
+    const Vec4f* v = t.v;
+    const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+    if (area != 0.f) {
+        const float inv_area = 1.f / area;
+        payload.tex_coords_dx = (t.texCoords[0] * (v[1].y - v[2].y) + t.texCoords[1] * (v[2].y - v[0].y) + t.texCoords[2] * (v[0].y - v[1].y)) * inv_area;
+        payload.tex_coords_dy = (t.texCoords[0] * (v[2].x - v[1].x) + t.texCoords[1] * (v[0].x - v[2].x) + t.texCoords[2] * (v[1].x - v[0].x)) * inv_area;
+    }
+    return fragmentShader(payload);
+}
+
+void rst::rasterizer::resolve_visibility(bool super) {
+    const int samples = super ? sample_count : 1;
+    // 每一行只读写自己的像素，行与行之间互不影响
+    // MSAA 时同一个三角形在像素内的采样点共用一次着色结果
+    const bool shade_per_pixel = super && antialiasing == AntiAliasing::MSAA;
+    pool->parallel_for(height, [this, super, samples, shade_per_pixel](int j) {
+        std::vector<int> shaded(samples); // 本像素中已解析的采样点所属的三角形
+        for (int i = 0; i < width; i++) {
+            Vec2i point(i, j);
+            int base = super ? get_super_index(i, j) : i + j * width;
+            for (int k = 0; k < samples; k++) {
+                VisibilitySample& sample = visibility_buffer[base + k];
+                shaded[k] = sample.triangle;
+                if (sample.triangle < 0) continue;
+                int same = shade_per_pixel ? static_cast<int>(std::find(shaded.begin(), shaded.begin() + k, sample.triangle) - shaded.begin()) : k;
+                Vec3f color = same < k
+                    ? super_frame_buffer[base + same]
+                    : shade_fragment(screen_triangles[sample.triangle], view_positions[sample.triangle], sample.bary[0], sample.bary[1], sample.bary[2]);
+                if (super) {
+                    super_frame_buffer[base + k] = color;
+                }
+                else {
+                    set_pixel(point, color);
+                }
+                sample.triangle = -1;
+            }
+        }
+    });
+}
 
-            // 计算屏幕坐标
-            vec.x = w / 2.f * vec.x + w / 2.f + x_offset;
-            vec.y = h / 2.f * vec.y + h / 2.f + y_offset;
-            vec.z = vec.z * f1 + f2;
+void rst::rasterizer::resolve(ResolveFilter filter) {
+    // 滤波器覆盖输出像素周围 (2 * radius + 1) x (2 * radius + 1) 个像素，其中每个像素的每个采样点都有一个权重
+    const int radius = filter == ResolveFilter::Box ? 0 : 1;
+    const int span = 2 * radius + 1;
+    constexpr float gaussian_sigma = 0.5f;
+    std::vector<float> weights(span * span * sample_count);
+    float total = 0.f;
+    for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            for (int k = 0; k < sample_count; k++) {
+                // 采样点相对输出像素中心的偏移
+                float ox = dx + sample_positions[k].x - 0.5f;
+                float oy = dy + sample_positions[k].y - 0.5f;
+                float w = 1.f;
+                if (filter == ResolveFilter::Tent) {
+                    w = std::max(0.f, 1.f - std::fabs(ox)) * std::max(0.f, 1.f - std::fabs(oy));
+                }
+                else if (filter == ResolveFilter::Gaussian) {
+                    w = std::exp(-(ox * ox + oy * oy) / (2.f * gaussian_sigma * gaussian_sigma));
+                }
+                weights[((dy + radius) * span + dx + radius) * sample_count + k] = w;
+                total += w;
+            }
         }
+    }
+    // 盒式滤波先求和再除以采样点数，与原来逐像素求平均的顺序相同；其它滤波器直接把权重归一化
+    const float scale = filter == ResolveFilter::Box ? 1 / float(sample_count) : 1.f;
+    if (filter != ResolveFilter::Box) {
+        for (auto& w : weights) w /= total;
+    }
 
-        // 将新的顶点坐标存储在新的三角形中
-        for (int i = 0; i < 3; i++) {
-            newtri.v[i] = v[i];
+    // 每一行只写帧缓冲区中自己的像素，超采样缓冲区只读，行与行之间互不影响。内核一次解析一整行
+    pool->parallel_for(height, [this, radius, scale, &weights](int j) {
+        ResolveInput in;
+        for (int dy = -radius; dy <= radius; dy++) {
+            in.rows[dy + radius] = &super_frame_buffer[get_super_index(0, std::clamp(j + dy, 0, height - 1))].x;
         }
+        in.weights = weights.data();
+        in.radius = radius;
+        in.width = width;
+        in.sample_count = sample_count;
+        in.scale = scale;
+        in.out = &frame_buffer[j * width].x;
+        resolve_kernel(in);
+    });
+}
 
+/**
+ * @brief 计算三角形与给定区域相交部分的包围盒
+ *
+ * @param t 屏幕空间中的三角形
+ * @param bounds 限制区域
+ * @param box 输出的包围盒
+ * @return 包围盒与限制区域不相交时返回false
+ */
+static bool clampedBoundingBox(const Triangle& t, const rst::Rect& bounds, rst::Rect& box) {
+    float minx = std::min({ t.v[0].x,t.v[1].x,t.v[2].x });
+    float maxx = std::max({ t.v[0].x,t.v[1].x,t.v[2].x });
+    float miny = std::min({ t.v[0].y,t.v[1].y,t.v[2].y });
+    float maxy = std::max({ t.v[0].y,t.v[1].y,t.v[2].y });
 
-        //newtri.computeFColor({ 1,0,0 });
-        //newtri.computeGColor({ 1,0,0 });
-        //newtri.setFlatNormal();
-        newtri.setColor(0, 148, 121.0, 92.0);
-        newtri.setColor(1, 148, 121.0, 92.0);
-        newtri.setColor(2, 148, 121.0, 92.0);
+    // 先在浮点数范围内判断是否相交，避免把超出 int 范围的坐标（或 NaN）直接转换为整数
+    if (!(maxx > bounds.min_x - 1.f && minx < bounds.max_x + 1.f && maxy > bounds.min_y - 1.f && miny < bounds.max_y + 1.f)) {
+        return false;
+    }
 
+    box.min_x = std::max((int)std::floor(std::max(minx, (float)bounds.min_x)), bounds.min_x);
+    box.max_x = std::min((int)std::ceil(std::min(maxx, (float)bounds.max_x)), bounds.max_x);
+    box.min_y = std::max((int)std::floor(std::max(miny, (float)bounds.min_y)), bounds.min_y);
+    box.max_y = std::min((int)std::ceil(std::min(maxy, (float)bounds.max_y)), bounds.max_y);
+    return box.min_x <= box.max_x && box.min_y <= box.max_y;
+}
 
-        // 光栅化新三角形，生成最终的图像
-        //rasterizer_triangle(newtri);
-        //rasterizer_triangle_msaa(newtri,2);
-        //rasterizer_triangle_new(newtri,viewspace_pos);
-        rasterizer_triangle_msaa_new(newtri, viewspace_pos, 2);
+/**
+ * @brief 三角形建立阶段的结果：三条边函数的系数和三角形面积的倒数
+ *
+ * 边函数 E_k(x, y) = a[k] * (x - px[k]) + b[k] * (y - py[k])，(px[k], py[k]) 是顶点 k 对边的起点。
+ * E_0、E_1、E_2 分别与顶点 0、1、2 的重心坐标成正比，即 alpha = E_0 * inv_area，beta、gamma 同理。
+ * 建立阶段已经统一了三角形的绕序，使三角形内部（含边界）的三个边函数都非负。
+ * 边函数对 x、y 都是线性的，所以相邻像素之间只需要分别加上 a[k] 或 b[k]，光栅化内循环中不再有除法。
+ */
+struct EdgeSetup {
+    float a[3], b[3];
+    float px[3], py[3];
+    float inv_area;
+    // 深度平面 z(x, y) = z0 + zdx * (x - x0) + zdy * (y - y0)，(x0, y0) 是顶点 0，以及三个顶点深度的范围
+    float x0, y0, z0, zdx, zdy;
+    float zmin, zmax;
+
+    // 直接计算边函数在点(x,y)处的值，只在每块区域的起点使用，之后都是增量步进
+    float at(int k, float x, float y) const { return a[k] * (x - px[k]) + b[k] * (y - py[k]); }
+};
+
+/**
+ * @brief 三角形建立阶段，每个三角形只执行一次
+ *
+ * @param pts 三角形的三个屏幕空间顶点
+ * @param e 输出的边函数系数
+ * @return 三角形退化（面积为0或坐标不是有限值）时返回false，此时不需要光栅化
+ */
+static bool setupEdges(const Vec4f* pts, EdgeSetup& e) {
+    for (int k = 0; k < 3; k++) {
+        // 边 k 是顶点 k 的对边，从顶点 k+1 指向顶点 k+2
+        const Vec4f& p1 = pts[(k + 1) % 3];
+        const Vec4f& p2 = pts[(k + 2) % 3];
+        e.a[k] = p1.y - p2.y;
+        e.b[k] = p2.x - p1.x;
+        e.px[k] = p1.x;
+        e.py[k] = p1.y;
     }
+
+    // 三角形有向面积的两倍，也就是顶点 0 处的 E_0
+    float area = e.at(0, pts[0].x, pts[0].y);
+    if (!std::isfinite(area) || area == 0.f) return false;
+
+    // 顺时针的三角形把三条边函数都取反，这样内部判断统一为三个边函数都非负
+    if (area < 0) {
+        for (int k = 0; k < 3; k++) {
+            e.a[k] = -e.a[k];
+            e.b[k] = -e.b[k];
+        }
+        area = -area;
+    }
+    e.inv_area = 1.f / area;
+
+    // 深度对屏幕坐标是线性的，梯度就是边函数系数按顶点深度加权
+    e.x0 = pts[0].x;
+    e.y0 = pts[0].y;
+    e.z0 = pts[0].z;
+    e.zdx = (e.a[0] * pts[0].z + e.a[1] * pts[1].z + e.a[2] * pts[2].z) * e.inv_area;
+    e.zdy = (e.b[0] * pts[0].z + e.b[1] * pts[1].z + e.b[2] * pts[2].z) * e.inv_area;
+    e.zmin = std::min({ pts[0].z, pts[1].z, pts[2].z });
+    e.zmax = std::max({ pts[0].z, pts[1].z, pts[2].z });
+    return true;
 }
 
 /**
- * @brief 计算点(x,y)在三角形内的重心坐标
+ * @brief 估计三角形在正方形区域 [x, x + size] x [y, y + size] 内的深度范围
+ *
+ * 深度平面在正方形上的最值出现在角点上；区域内被覆盖的采样点同时也在三角形内，深度不会超出三个顶点的深度范围，
+ * 所以取两者的交集。结果再向外放宽一点，抵消批量内核逐采样点插值时的舍入误差，保证估计是保守的。
  *
- * @param pts 三角形的三个顶点，类型为Vec4f结构体数组
- * @param x 待计算重心坐标的点的x坐标
- * @param y 待计算重心坐标的点的y坐标
- * @return 一个tuple类型的值，包含三个浮点数alpha、beta和gamma，它们分别表示点(x,y)在三角形内的三个顶点上的重心坐标
+ * @param e 三角形的边函数和深度平面
+ * @param x 区域左下角的x坐标
+ * @param y 区域左下角的y坐标
+ * @param size 区域边长
+ * @param zmin 输出的最小深度
+ * @param zmax 输出的最大深度
  */
-static std::tuple<float, float, float> computeBarycentric2D(const Vec4f* pts, float x, float y) {
-    // 从Vec4f结构体数组pts中获取三角形的三个顶点坐标
-    float xa = pts[0].x;
-    float ya = pts[0].y;
-    float xb = pts[1].x;
-    float yb = pts[1].y;
-    float xc = pts[2].x;
-    float yc = pts[2].y;
+static void blockDepthRange(const EdgeSetup& e, int x, int y, int size, float& zmin, float& zmax) {
+    float corner = e.z0 + e.zdx * (x - e.x0) + e.zdy * (y - e.y0);
+    float lo = corner + (std::min(e.zdx, 0.f) + std::min(e.zdy, 0.f)) * size;
+    float hi = corner + (std::max(e.zdx, 0.f) + std::max(e.zdy, 0.f)) * size;
+    zmin = std::max(lo, e.zmin);
+    zmax = std::min(hi, e.zmax);
+    float slack = 1e-5f * (std::fabs(e.zmin) + std::fabs(e.zmax) + 1.f);
+    zmin -= slack;
+    zmax += slack;
+}
 
-    // 计算点(x,y)在三角形内的重心坐标alpha、beta和gamma
-    float gamma = ((ya - yb) * x + (xb - xa) * y + xa * yb - xb * ya) / ((ya - yb) * xc + (xb - xa) * yc + xa * yb - xb * ya);
-    float beta = ((ya - yc) * x + (xc - xa) * y + xa * yc - xc * ya) / ((ya - yc) * xb + (xc - xa) * yb + xa * yc - xc * ya);
-    float alpha = 1 - gamma - beta;
 
-    // 将alpha、beta和gamma作为tuple类型的值返回
-    return { alpha, beta, gamma };
+/**
+ * @brief 正方形像素区域与三角形的位置关系
+ */
+enum class BlockCoverage {
+    Outside, // 完全在三角形外部
+    Partial, // 与三角形边界相交，需要逐采样点测试
+    Inside   // 完全在三角形内部
+};
+
+/**
+ * @brief 用三条边函数对正方形区域 [x, x + size] x [y, y + size] 做整体测试
+ *
+ * 边函数是线性的，在正方形上的最大值和最小值都出现在角点上，由系数的符号决定是哪个角点。
+ * 某条边函数的最大值小于0说明整个区域都在该边外侧；三条边函数的最小值都不小于0说明整个区域都在三角形内部。
+ * 区域内所有采样点（像素中心或超采样点）都落在这个正方形里，所以判断结果对它们都成立。
+ *
+ * @param e 三角形的边函数
+ * @param x 区域左下角的x坐标
+ * @param y 区域左下角的y坐标
+ * @param size 区域边长
+ * @param corner 输出三条边函数在左下角处的值，供遍历区域时使用
+ * @return 区域与三角形的位置关系
+ */
+static BlockCoverage classifyBlock(const EdgeSetup& e, int x, int y, int size, float corner[3]) {
+    bool inside = true;
+    for (int k = 0; k < 3; k++) {
+        corner[k] = e.at(k, (float)x, (float)y);
+        float max_value = corner[k] + (std::max(e.a[k], 0.f) + std::max(e.b[k], 0.f)) * size;
+        float min_value = corner[k] + (std::min(e.a[k], 0.f) + std::min(e.b[k], 0.f)) * size;
+        if (max_value < 0) return BlockCoverage::Outside;
+        if (min_value < 0) inside = false;
+    }
+    return inside ? BlockCoverage::Inside : BlockCoverage::Partial;
 }
 
+void rst::rasterizer::bin_triangles() {
+    for (auto& tile : tiles) {
+        tile.triangles.clear();
+    }
+
+    const Rect screen = { 0, 0, width - 1, height - 1 };
+    for (int idx = 0; idx < static_cast<int>(screen_triangles.size()); idx++) {
+        Rect box;
+        if (!clampedBoundingBox(screen_triangles[idx], screen, box)) continue;
+
+        // 退化三角形不会覆盖任何像素，不需要分配
+        EdgeSetup e;
+        if (!setupEdges(screen_triangles[idx].v, e)) continue;
+
+        int tile_x0 = box.min_x / tile_size, tile_x1 = box.max_x / tile_size;
+        int tile_y0 = box.min_y / tile_size, tile_y1 = box.max_y / tile_size;
+        bool single_tile = tile_x0 == tile_x1 && tile_y0 == tile_y1;
+
+        // 三角形按顺序追加到它覆盖的每个分块中，所以每个分块内的顺序就是提交顺序
+        for (int ty = tile_y0; ty <= tile_y1; ty++) {
+            for (int tx = tile_x0; tx <= tile_x1; tx++) {
+                // 细长的斜三角形包围盒很大，但大部分分块与三角形并不相交
+                float corner[3];
+                if (!single_tile && classifyBlock(e, tx * tile_size, ty * tile_size, tile_size, corner) == BlockCoverage::Outside) continue;
+                tiles[ty * tiles_x + tx].triangles.push_back(idx);
+            }
+        }
+    }
+}
+
+void rst::rasterizer::update_block_depth(bool super, int block_x, int block_y) {
+    // 屏幕边缘的像素块可能不满 8x8，只统计屏幕内的像素
+    const int x1 = std::min(block_x + block_size, width);
+    const int y1 = std::min(block_y + block_size, height);
+    float zmin = std::numeric_limits<float>::infinity();
+    float zmax = -std::numeric_limits<float>::infinity();
+    for (int j = block_y; j < y1; j++) {
+        // 一行像素的深度值（超采样时包括每个像素的全部采样点）在缓冲区中是连续的
+        const float* first;
+        const float* last;
+        if (super) {
+            first = &super_depth_buffer[get_super_index(block_x, j)];
+            last = first + (x1 - block_x) * sample_count;
+        }
+        else {
+            first = &depth_buffer[block_x + j * width];
+            last = first + (x1 - block_x);
+        }
+        for (const float* d = first; d != last; d++) {
+            zmin = std::min(zmin, *d);
+            zmax = std::max(zmax, *d);
+        }
+    }
+
+    DepthPyramid& hz = super ? super_hiz : hiz;
+    const int index = (block_y / block_size) * blocks_x + block_x / block_size;
+    hz.block_min[index] = zmin;
+    hz.block_max[index] = zmax;
+}
+
+void rst::rasterizer::update_tile_depth(bool super, const Rect& tile_rect) {
+    DepthPyramid& hz = super ? super_hiz : hiz;
+    float zmin = std::numeric_limits<float>::infinity();
+    float zmax = -std::numeric_limits<float>::infinity();
+    for (int by = tile_rect.min_y / block_size; by <= tile_rect.max_y / block_size; by++) {
+        for (int bx = tile_rect.min_x / block_size; bx <= tile_rect.max_x / block_size; bx++) {
+            zmin = std::min(zmin, hz.block_min[by * blocks_x + bx]);
+            zmax = std::max(zmax, hz.block_max[by * blocks_x + bx]);
+        }
+    }
+
+    const int index = (tile_rect.min_y / tile_size) * tiles_x + tile_rect.min_x / tile_size;
+    hz.tile_min[index] = zmin;
+    hz.tile_max[index] = zmax;
+}
 
 //void rst::rasterizer::rasterizer_triangle_msaa(Triangle& t, int sample_count = 2) {
 //	const Vec4f* pts = t.v;
@@ -234,206 +1022,277 @@ static std::tuple<float, float, float> computeBarycentric2D(const Vec4f* pts, fl
 //}
 
 
-void rst::rasterizer::rasterizer_triangle(Triangle& t) {
+void rst::rasterizer::rasterizer_triangle(Triangle& t, const Rect& bounds) {
+    // 视图空间坐标全部为零，插值结果与不设置 view_pos 相同
+    static const std::array<Vec3f, 3> no_view_pos{};
+    rasterizer_triangle_new(t, no_view_pos, -1, bounds);
+}
+
+void rst::rasterizer::rasterizer_triangle_msaa(Triangle& t, const Rect& bounds) {
+    // 视图空间坐标全部为零，插值结果与不设置 view_pos 相同
+    static const std::array<Vec3f, 3> no_view_pos{};
+    rasterizer_triangle_msaa_new(t, no_view_pos, -1, bounds);
+}
+
+void rst::rasterizer::rasterizer_triangle_new(Triangle& t, const std::array<Vec3f, 3>& view_pos, int triangle_id, const Rect& bounds) {
+    // 8x8 像素块的一行直接作为批量内核的 8 个 lane
+    static_assert(block_size == block_lanes, "block_size must match block_lanes");
     const Vec4f* pts = t.v;
 
-    float minx = std::min({ t.v[0].x,t.v[1].x,t.v[2].x });
-    float maxx = std::max({ t.v[0].x,t.v[1].x,t.v[2].x });
-    float miny = std::min({ t.v[0].y,t.v[1].y,t.v[2].y });
-    float maxy = std::max({ t.v[0].y,t.v[1].y,t.v[2].y });
+    // 包围盒裁剪到 bounds 内，保证只写当前分块的像素
+    Rect box;
+    if (!clampedBoundingBox(t, bounds, box)) return;
 
-    int min_x = (int)std::floor(minx);
-    int max_x = (int)std::ceil(maxx);
-    int min_y = (int)std::floor(miny);
-    int max_y = (int)std::ceil(maxy);
+    // 三角形建立：边函数系数和面积倒数只计算一次，退化三角形直接跳过
+    EdgeSetup e;
+    if (!setupEdges(pts, e)) return;
 
-    for (int i = min_x; i <= max_x; i++) {
-        for (int j = min_y; j <= max_y; j++) {
-            Vec2i point(i, j);
+    // 分层深度：三角形在整个分块内都不比分块中最远的已绘制深度更近时，整个三角形在该分块内被遮挡
+    const int tile_index = (bounds.min_y / tile_size) * tiles_x + bounds.min_x / tile_size;
+    float tri_zmin, tri_zmax;
+    blockDepthRange(e, bounds.min_x, bounds.min_y, tile_size, tri_zmin, tri_zmax);
+    if (tri_zmax <= hiz.tile_min[tile_index]) return;
+    bool tile_written = false;
 
-            /*
-             *像素通常被看作是一个点，其坐标为左上角的整数坐标。
-             *例如，(0,0)表示屏幕左上角的像素，(1,0)表示屏幕上第二个像素，(0,1)表示屏幕左边第二个像素。
-             *如果我们直接使用整数坐标来计算像素的重心坐标，那么很有可能会出现误差，导致像素填充不完整或者出现锯齿形状。
-             *因此，在计算重心坐标时，我们通常会将像素坐标加上0.5，这样可以将像素坐标放在像素中心位置，从而减小误差和锯齿的出现。
-            */
-            auto [alpha, beta, gamma] = computeBarycentric2D(pts, static_cast<float>(i + 0.5), static_cast<float>(j + 0.5));
-            if (alpha < 0 || beta < 0 || gamma < 0) continue;
-
-            // 对于每个在三角形内部的像素点，计算出其深度值、纹理坐标、颜色和法向量等信息，并调用fragmentShader函数对这些信息进行处理，得到最终的像素颜色
-            float z_interpolation = alpha * pts[0].z + beta * pts[1].z + gamma * pts[2].z;
-            Vec2f uv_interpolation = t.texCoords[0] * alpha + t.texCoords[1] * beta + t.texCoords[2] * gamma;
-            Vec3f color_interpolation = t.color[0] * alpha + t.color[1] * beta + t.color[2] * gamma;
-            Vec3f normal_interpolation = t.normal[0] * alpha + t.normal[1] * beta + t.normal[2] * gamma;
-            //fragment_shader_payload payload(color_interpolation, normal_interpolation, uv_interpolation, texture ? &*texture : nullptr);
-            fragment_shader_payload payload(color_interpolation, normal_interpolation, uv_interpolation, texture ? &*texture : nullptr, t.flatNormal);
-
-            // 比较当前像素点的深度值与深度缓冲区中该像素点处的深度值，如果当前像素点的深度值更大，则将其深度值更新，并将最终的像素颜色赋值给该像素点
-            if (z_interpolation > depth_buffer[static_cast<int>(i + j * width)]) {
-                depth_buffer[static_cast<int>(i + j * width)] = z_interpolation;
-                auto pixel_color = fragmentShader(payload);
-                set_pixel(point, pixel_color); // 设置像素点颜色
-            }
+    // 像素块中一行 8 个像素的中心（+0.5）相对块左下角的边函数增量，从而减小误差和锯齿
+    alignas(32) float lane_offset[3 * block_lanes];
+    for (int k = 0; k < 3; k++) {
+        for (int l = 0; l < block_lanes; l++) {
+            lane_offset[k * block_lanes + l] = e.a[k] * (l + 0.5f) + e.b[k] * 0.5f;
         }
     }
-}
 
-void rst::rasterizer::rasterizer_triangle_msaa(Triangle& t, int sample_count = 2) {
-	const Vec4f* pts = t.v;
-
-	float minx = std::min({ t.v[0].x,t.v[1].x,t.v[2].x });
-	float maxx = std::max({ t.v[0].x,t.v[1].x,t.v[2].x });
-	float miny = std::min({ t.v[0].y,t.v[1].y,t.v[2].y });
-	float maxy = std::max({ t.v[0].y,t.v[1].y,t.v[2].y });
-
-	int min_x = (int)std::floor(minx);
-	int max_x = (int)std::ceil(maxx);
-	int min_y = (int)std::floor(miny);
-	int max_y = (int)std::ceil(maxy);
-
-	for (int i = min_x; i <= max_x; i++) {
-		for (int j = min_y; j <= max_y; j++) {
-			Vec2i point(i, j);
-            //判断是否通过了深度测试
-            int judge = 0;
-			for (int k = 0; k < sample_count * sample_count; k++)
-			{
-				auto [alpha, beta, gamma] = computeBarycentric2D(pts, static_cast<float>(i + getSuperSampleStep(sample_count)[k].x), static_cast<float>(j + getSuperSampleStep(sample_count)[k].y));
-				if (alpha < 0 || beta < 0 || gamma < 0) continue;
-				// 对于每个在三角形内部的像素点，计算出其深度值、纹理坐标、颜色和法向量等信息，并调用fragmentShader函数对这些信息进行处理，得到最终的像素颜色
-				float z_interpolation = alpha * pts[0].z + beta * pts[1].z + gamma * pts[2].z;
-				Vec2f uv_interpolation = t.texCoords[0] * alpha + t.texCoords[1] * beta + t.texCoords[2] * gamma;
-				Vec3f color_interpolation = t.color[0] * alpha + t.color[1] * beta + t.color[2] * gamma;
-				Vec3f normal_interpolation = t.normal[0] * alpha + t.normal[1] * beta + t.normal[2] * gamma;
-                //fragment_shader_payload payload(color_interpolation, normal_interpolation, uv_interpolation, texture ? &*texture : nullptr);
-                fragment_shader_payload payload(color_interpolation, normal_interpolation, uv_interpolation, texture ? &*texture : nullptr, t.flatNormal);
-				// 比较当前像素点的深度值与深度缓冲区中该像素点处的深度值，如果当前像素点的深度值更大，则将其深度值更新，并将最终的像素颜色赋值给该像素点
-				if (z_interpolation > super_depth_buffer[get_super_index(i, j, sample_count)+k]) {
-                    judge = 1;
-                    auto pixel_color = fragmentShader(payload);
-                    super_depth_buffer[get_super_index(i, j, sample_count) + k] = z_interpolation;
-                    super_frame_buffer[get_super_index(i, j, sample_count) + k] = pixel_color;
-				}
-			}
-            if (judge)
-                //若像素的四个样本中有一个通过了深度测试，就需要对该像素进行着色，因为有一个通过就说明有颜色，就需要着色。
-            {
-                Vec3f color = Vec3f(0.0f, 0.0f, 0.0f);
-                for (int l = 0; l < sample_count; ++l) {
-                    for (int m = 0; m < sample_count; ++m) {
-                        color = color + super_frame_buffer[get_super_index(i, j, sample_count) + l * sample_count + m];
+    BlockInput in;
+    in.offset = lane_offset;
+    in.inv_area = e.inv_area;
+    for (int k = 0; k < 3; k++) in.z[k] = pts[k].z;
+    BlockOutput out;
+    float depth_tail[block_lanes] = {};
+
+    // 按 8x8 像素块遍历包围盒，完全在三角形外部的块直接跳过，完全在内部的块省去逐像素的覆盖测试
+    for (int block_y = box.min_y - box.min_y % block_size; block_y <= box.max_y; block_y += block_size) {
+        for (int block_x = box.min_x - box.min_x % block_size; block_x <= box.max_x; block_x += block_size) {
+            float corner[3];
+            BlockCoverage coverage = classifyBlock(e, block_x, block_y, block_size, corner);
+            if (coverage == BlockCoverage::Outside) continue;
+            in.test_coverage = coverage == BlockCoverage::Partial;
+
+            // 分层深度：整块被遮挡时跳过，三角形比块内最近的深度还近时省去逐像素的深度测试
+            const int hiz_index = (block_y / block_size) * blocks_x + block_x / block_size;
+            float block_zmin, block_zmax;
+            blockDepthRange(e, block_x, block_y, block_size, block_zmin, block_zmax);
+            if (block_zmax <= hiz.block_min[hiz_index]) continue;
+            in.test_depth = !(block_zmin > hiz.block_max[hiz_index]);
+            unsigned written = 0;
+
+            // 块与包围盒相交的部分
+            int x0 = std::max(block_x, box.min_x), x1 = std::min(block_x + block_size - 1, box.max_x);
+            int y0 = std::max(block_y, box.min_y), y1 = std::min(block_y + block_size - 1, box.max_y);
+            in.lane_mask = ((1u << (x1 - block_x + 1)) - 1) & ~((1u << (x0 - block_x)) - 1);
+
+            for (int k = 0; k < 3; k++) in.base[k] = corner[k] + e.b[k] * (y0 - block_y);
+            for (int j = y0; j <= y1; j++) {
+                float* depth = &depth_buffer[block_x + j * width];
+                // 块的一行有像素落在包围盒外时只拷贝包围盒内的深度值，避免越界或读到其它分块正在写的像素
+                if (x0 != block_x || x1 != block_x + block_lanes - 1) {
+                    std::copy(depth + (x0 - block_x), depth + (x1 - block_x) + 1, depth_tail + (x0 - block_x));
+                    in.depth = depth_tail;
+                }
+                else {
+                    in.depth = depth;
+                }
+
+                // 一次完成 8 个像素的覆盖和深度测试，只有通过测试的像素才插值属性并调用片段着色器
+                unsigned mask = block_kernel(in, out);
+                written |= mask;
+                for (int l = 0; mask; l++, mask >>= 1) {
+                    if (!(mask & 1u)) continue;
+                    Vec2i point(block_x + l, j);
+                    float alpha = out.bary[0][l], beta = out.bary[1][l], gamma = out.bary[2][l];
+
+                    depth[l] = out.z[l];
+                    if (shading_mode == ShadingMode::Deferred) {
+                        // 延迟着色只记录可见性，被后面的三角形覆盖时不会浪费着色
+                        visibility_buffer[point.x + j * width] = { triangle_id, { alpha, beta, gamma } };
+                        continue;
                     }
+
+                    auto pixel_color = shade_fragment(t, view_pos, alpha, beta, gamma);
+                    set_pixel(point, pixel_color); // 设置像素点颜色
                 }
-                color = color * (1 / float(sample_count * sample_count));
-                set_pixel(point, color);
+                for (int k = 0; k < 3; k++) in.base[k] += e.b[k];
+            }
+
+            // 块内深度有变化时重新统计分层深度
+            if (written) {
+                update_block_depth(false, block_x, block_y);
+                tile_written = true;
             }
-		}
-	}
+        }
+    }
+    if (tile_written) update_tile_depth(false, bounds);
 }
 
+void rst::rasterizer::rasterizer_triangle_msaa_new(Triangle& t, const std::array<Vec3f, 3>& view_pos, int triangle_id, const Rect& bounds) {
+    // 采样点数在构造时已经确定，这里只是选择对应的模板实例
+    switch (sample_count) {
+    case 1: rasterizer_triangle_msaa_impl<1>(t, view_pos, triangle_id, bounds); break;
+    case 2: rasterizer_triangle_msaa_impl<2>(t, view_pos, triangle_id, bounds); break;
+    case 4: rasterizer_triangle_msaa_impl<4>(t, view_pos, triangle_id, bounds); break;
+    case 8: rasterizer_triangle_msaa_impl<8>(t, view_pos, triangle_id, bounds); break;
+    default: rasterizer_triangle_msaa_impl<16>(t, view_pos, triangle_id, bounds); break;
+    }
+}
 
-void rst::rasterizer::rasterizer_triangle_new(Triangle& t, std::vector<Vec3f> view_pos) {
+template <int Samples>
+void rst::rasterizer::rasterizer_triangle_msaa_impl(Triangle& t, const std::array<Vec3f, 3>& view_pos, int triangle_id, const Rect& bounds) {
+    static_assert(is_supported_sample_count(Samples), "unsupported sample count");
     const Vec4f* pts = t.v;
 
-    float minx = std::min({ t.v[0].x,t.v[1].x,t.v[2].x });
-    float maxx = std::max({ t.v[0].x,t.v[1].x,t.v[2].x });
-    float miny = std::min({ t.v[0].y,t.v[1].y,t.v[2].y });
-    float maxy = std::max({ t.v[0].y,t.v[1].y,t.v[2].y });
+    // 包围盒裁剪到 bounds 内，保证只写当前分块的像素
+    Rect box;
+    if (!clampedBoundingBox(t, bounds, box)) return;
 
-    int min_x = (int)std::floor(minx);
-    int max_x = (int)std::ceil(maxx);
-    int min_y = (int)std::floor(miny);
-    int max_y = (int)std::ceil(maxy);
+    // 三角形建立：边函数系数和面积倒数只计算一次，退化三角形直接跳过
+    EdgeSetup e;
+    if (!setupEdges(pts, e)) return;
 
-    for (int i = min_x; i <= max_x; i++) {
-        for (int j = min_y; j <= max_y; j++) {
-            Vec2i point(i, j);
+    // 分层深度：三角形在整个分块内都不比分块中最远的已绘制深度更近时，整个三角形在该分块内被遮挡
+    const int tile_index = (bounds.min_y / tile_size) * tiles_x + bounds.min_x / tile_size;
+    float tri_zmin, tri_zmax;
+    blockDepthRange(e, bounds.min_x, bounds.min_y, tile_size, tri_zmin, tri_zmax);
+    if (tri_zmax <= super_hiz.tile_min[tile_index]) return;
+    bool tile_written = false;
 
-            /*
-             *像素通常被看作是一个点，其坐标为左上角的整数坐标。
-             *例如，(0,0)表示屏幕左上角的像素，(1,0)表示屏幕上第二个像素，(0,1)表示屏幕左边第二个像素。
-             *如果我们直接使用整数坐标来计算像素的重心坐标，那么很有可能会出现误差，导致像素填充不完整或者出现锯齿形状。
-             *因此，在计算重心坐标时，我们通常会将像素坐标加上0.5，这样可以将像素坐标放在像素中心位置，从而减小误差和锯齿的出现。
-            */
-            auto [alpha, beta, gamma] = computeBarycentric2D(pts, static_cast<float>(i + 0.5), static_cast<float>(j + 0.5));
-            if (alpha < 0 || beta < 0 || gamma < 0) continue;
-
-            // 对于每个在三角形内部的像素点，计算出其深度值、纹理坐标、颜色和法向量等信息，并调用fragmentShader函数对这些信息进行处理，得到最终的像素颜色
-            float z_interpolation = alpha * pts[0].z + beta * pts[1].z + gamma * pts[2].z;
-            Vec2f uv_interpolation = t.texCoords[0] * alpha + t.texCoords[1] * beta + t.texCoords[2] * gamma;
-            Vec3f color_interpolation = t.color[0] * alpha + t.color[1] * beta + t.color[2] * gamma;
-            Vec3f normal_interpolation = t.normal[0] * alpha + t.normal[1] * beta + t.normal[2] * gamma;
-            Vec3f shadingcoords_interpolated = view_pos[0] * alpha + view_pos[1] * beta + view_pos[2] * gamma;
-
-            //fragment_shader_payload payload(color_interpolation, normal_interpolation, uv_interpolation, texture ? &*texture : nullptr);
-            fragment_shader_payload payload(color_interpolation, normal_interpolation, uv_interpolation, texture ? &*texture : nullptr, t.flatNormal);
-
-            payload.view_pos = shadingcoords_interpolated;
-
-            // 比较当前像素点的深度值与深度缓冲区中该像素点处的深度值，如果当前像素点的深度值更大，则将其深度值更新，并将最终的像素颜色赋值给该像素点
-            if (z_interpolation > depth_buffer[static_cast<int>(i + j * width)]) {
-                depth_buffer[static_cast<int>(i + j * width)] = z_interpolation;
-                auto pixel_color = fragmentShader(payload);
-                set_pixel(point, pixel_color); // 设置像素点颜色
-            }
+    // 每个采样点相对像素左下角的边函数增量，同一个三角形内所有像素共用。
+    // 采样点按 8 个一组排列，每组对应一次批量内核调用，最后一组不满时多余的 lane 增量为 0
+    constexpr int groups = (Samples + block_lanes - 1) / block_lanes;
+    alignas(32) float sample_offset[groups * 3 * block_lanes] = {};
+    unsigned group_masks[groups]; // MSAA 时记录每组通过测试的采样点，等整个像素测试完再统一写颜色
+    for (int k = 0; k < Samples; k++) {
+        int g = k / block_lanes, l = k % block_lanes;
+        for (int m = 0; m < 3; m++) {
+            sample_offset[(g * 3 + m) * block_lanes + l] = e.a[m] * sample_positions[k].x + e.b[m] * sample_positions[k].y;
         }
     }
-}
 
-void rst::rasterizer::rasterizer_triangle_msaa_new(Triangle& t, std::vector<Vec3f> view_pos, int sample_count) {
-    const Vec4f* pts = t.v;
+    BlockInput in;
+    in.inv_area = e.inv_area;
+    for (int m = 0; m < 3; m++) in.z[m] = pts[m].z;
+    BlockOutput out;
+    float depth_tail[block_lanes] = {};
 
-    float minx = std::min({ t.v[0].x,t.v[1].x,t.v[2].x });
-    float maxx = std::max({ t.v[0].x,t.v[1].x,t.v[2].x });
-    float miny = std::min({ t.v[0].y,t.v[1].y,t.v[2].y });
-    float maxy = std::max({ t.v[0].y,t.v[1].y,t.v[2].y });
+    // 按 8x8 像素块遍历包围盒，完全在三角形外部的块直接跳过，完全在内部的块省去逐采样点的覆盖测试
+    for (int block_y = box.min_y - box.min_y % block_size; block_y <= box.max_y; block_y += block_size) {
+        for (int block_x = box.min_x - box.min_x % block_size; block_x <= box.max_x; block_x += block_size) {
+            float block_corner[3];
+            BlockCoverage coverage = classifyBlock(e, block_x, block_y, block_size, block_corner);
+            if (coverage == BlockCoverage::Outside) continue;
+            in.test_coverage = coverage == BlockCoverage::Partial;
 
-    int min_x = (int)std::floor(minx);
-    int max_x = (int)std::ceil(maxx);
-    int min_y = (int)std::floor(miny);
-    int max_y = (int)std::ceil(maxy);
+            // 分层深度：整块被遮挡时跳过，三角形比块内最近的采样点还近时省去逐采样点的深度测试
+            const int hiz_index = (block_y / block_size) * blocks_x + block_x / block_size;
+            float block_zmin, block_zmax;
+            blockDepthRange(e, block_x, block_y, block_size, block_zmin, block_zmax);
+            if (block_zmax <= super_hiz.block_min[hiz_index]) continue;
+            in.test_depth = !(block_zmin > super_hiz.block_max[hiz_index]);
+            bool written = false;
 
-    for (int i = min_x; i <= max_x; i++) {
-        for (int j = min_y; j <= max_y; j++) {
-            Vec2i point(i, j);
-            //判断是否通过了深度测试
-            int judge = 0;
-            for (int k = 0; k < sample_count * sample_count; k++)
-            {
-                auto [alpha, beta, gamma] = computeBarycentric2D(pts, static_cast<float>(i + getSuperSampleStep(sample_count)[k].x), static_cast<float>(j + getSuperSampleStep(sample_count)[k].y));
-                if (alpha < 0 || beta < 0 || gamma < 0) continue;
-                // 对于每个在三角形内部的像素点，计算出其深度值、纹理坐标、颜色和法向量等信息，并调用fragmentShader函数对这些信息进行处理，得到最终的像素颜色
-                float z_interpolation = alpha * pts[0].z + beta * pts[1].z + gamma * pts[2].z;
-                Vec2f uv_interpolation = t.texCoords[0] * alpha + t.texCoords[1] * beta + t.texCoords[2] * gamma;
-                Vec3f color_interpolation = t.color[0] * alpha + t.color[1] * beta + t.color[2] * gamma;
-                Vec3f normal_interpolation = t.normal[0] * alpha + t.normal[1] * beta + t.normal[2] * gamma;
-                Vec3f shadingcoords_interpolated = view_pos[0] * alpha + view_pos[1] * beta + view_pos[2] * gamma;
-
-                //fragment_shader_payload payload(color_interpolation, normal_interpolation, uv_interpolation, texture ? &*texture : nullptr);
-                fragment_shader_payload payload(color_interpolation, normal_interpolation, uv_interpolation, texture ? &*texture : nullptr, t.flatNormal);
-
-                payload.view_pos = shadingcoords_interpolated;
-
-                // 比较当前像素点的深度值与深度缓冲区中该像素点处的深度值，如果当前像素点的深度值更大，则将其深度值更新，并将最终的像素颜色赋值给该像素点
-                if (z_interpolation > super_depth_buffer[get_super_index(i, j, sample_count) + k]) {
-                    judge = 1;
-                    auto pixel_color = fragmentShader(payload);
-                    super_depth_buffer[get_super_index(i, j, sample_count) + k] = z_interpolation;
-                    super_frame_buffer[get_super_index(i, j, sample_count) + k] = pixel_color;
-                }
-            }
-            if (judge)
-                //若像素的四个样本中有一个通过了深度测试，就需要对该像素进行着色，因为有一个通过就说明有颜色，就需要着色。
-            {
-                Vec3f color = Vec3f(0.0f, 0.0f, 0.0f);
-                for (int l = 0; l < sample_count; ++l) {
-                    for (int m = 0; m < sample_count; ++m) {
-                        color = color + super_frame_buffer[get_super_index(i, j, sample_count) + l * sample_count + m];
+            // 块与包围盒相交的部分
+            int x0 = std::max(block_x, box.min_x), x1 = std::min(block_x + block_size - 1, box.max_x);
+            int y0 = std::max(block_y, box.min_y), y1 = std::min(block_y + block_size - 1, box.max_y);
+
+            float row[3];
+            for (int m = 0; m < 3; m++) row[m] = block_corner[m] + e.a[m] * (x0 - block_x) + e.b[m] * (y0 - block_y);
+            for (int j = y0; j <= y1; j++) {
+                float corner[3] = { row[0], row[1], row[2] };
+                for (int i = x0; i <= x1; i++) {
+                    const int index = get_super_index(i, j);
+                    float* depth = &super_depth_buffer[index];
+                    Vec3f* color_samples = &super_frame_buffer[index];
+                    VisibilitySample* visibility_samples = shading_mode == ShadingMode::Deferred ? &visibility_buffer[index] : nullptr;
+                    //判断是否通过了深度测试，记录通过测试的采样点数
+                    int judge = 0;
+                    float bary_sum[3] = { 0.f, 0.f, 0.f };
+                    for (int g = 0; g < groups; g++) {
+                        int first = g * block_lanes;
+                        constexpr int last_lanes = Samples - (groups - 1) * block_lanes;
+                        int lanes = g == groups - 1 ? last_lanes : block_lanes;
+                        for (int m = 0; m < 3; m++) in.base[m] = corner[m];
+                        in.offset = &sample_offset[g * 3 * block_lanes];
+                        in.lane_mask = (1u << lanes) - 1;
+                        // 采样点不满 8 个时拷贝到临时数组，避免读到相邻像素或越界
+                        if (lanes < block_lanes) {
+                            std::copy(depth + first, depth + first + lanes, depth_tail);
+                            in.depth = depth_tail;
+                        }
+                        else {
+                            in.depth = depth + first;
+                        }
+
+                        // 一次完成一组采样点的覆盖和深度测试，只有通过测试的采样点才插值属性并调用片段着色器
+                        unsigned mask = block_kernel(in, out);
+                        group_masks[g] = mask;
+                        for (int l = 0; mask; l++, mask >>= 1) {
+                            if (!(mask & 1u)) continue;
+                            int k = first + l;
+                            float alpha = out.bary[0][l], beta = out.bary[1][l], gamma = out.bary[2][l];
+
+                            judge++;
+                            depth[k] = out.z[l];
+                            if (antialiasing == AntiAliasing::MSAA) {
+                                // 多重采样：这里只做覆盖和深度测试，着色推迟到整个像素的采样点都测试完之后
+                                bary_sum[0] += alpha;
+                                bary_sum[1] += beta;
+                                bary_sum[2] += gamma;
+                                continue;
+                            }
+                            if (shading_mode == ShadingMode::Deferred) {
+                                // 延迟着色只记录可见性，被后面的三角形覆盖时不会浪费着色
+                                visibility_samples[k] = { triangle_id, { alpha, beta, gamma } };
+                                continue;
+                            }
+
+                            auto pixel_color = shade_fragment(t, view_pos, alpha, beta, gamma);
+                            color_samples[k] = pixel_color;
+                        }
+                    }
+                    if (judge && antialiasing == AntiAliasing::MSAA) {
+                        // 在通过测试的采样点的质心处着色一次。重心坐标是线性的，质心的重心坐标就是这些采样点重心坐标的平均值，
+                        // 而且质心一定在三角形内部，不会像像素中心那样在三角形边缘外插出错误的属性
+                        float alpha = bary_sum[0] / judge, beta = bary_sum[1] / judge, gamma = bary_sum[2] / judge;
+                        Vec3f pixel_color;
+                        if (shading_mode == ShadingMode::Forward) {
+                            pixel_color = shade_fragment(t, view_pos, alpha, beta, gamma);
+                        }
+                        for (int g = 0; g < groups; g++) {
+                            unsigned mask = group_masks[g];
+                            for (int l = 0; mask; l++, mask >>= 1) {
+                                if (!(mask & 1u)) continue;
+                                int k = g * block_lanes + l;
+                                if (shading_mode == ShadingMode::Deferred) {
+                                    // 同一个三角形在像素内的采样点记录相同的重心坐标，解析阶段据此只着色一次
+                                    visibility_samples[k] = { triangle_id, { alpha, beta, gamma } };
+                                }
+                                else {
+                                    color_samples[k] = pixel_color;
+                                }
+                            }
+                        }
                     }
+                    // 像素颜色由一帧结束时的 resolve 统一求出，这里只记录块内深度有变化
+                    if (judge) written = true;
+                    for (int m = 0; m < 3; m++) corner[m] += e.a[m];
                 }
-                color = color * (1 / float(sample_count * sample_count));
-                set_pixel(point, color);
+                for (int m = 0; m < 3; m++) row[m] += e.b[m];
+            }
+
+            // 块内深度有变化时重新统计分层深度
+            if (written) {
+                update_block_depth(true, block_x, block_y);
+                tile_written = true;
             }
         }
     }
-}
+    if (tile_written) update_tile_depth(true, bounds);
+}
\ No newline at end of file
@@ -6,14 +6,24 @@
 #pragma once
 
 #include <vector>
-#include <optional>
+#include <array>
+#include <memory>
 #include <functional>
 #include <limits>
+#include <algorithm>
 
 #include "geometry.h"
 #include "Texture.h"
 #include "Shader.h"
 #include "Triangle.h"
+#include "thread_pool.h"
+#include "raster_kernel.h"
+#include "vertex_stage.h"
+#include "mesh.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+#include "bvh.h"
+#include "sample_pattern.h"
 
 namespace rst {
 
@@ -37,6 +47,119 @@ namespace rst {
 	};
 	/**
 
+	@brief 枚举类，表示一次绘制使用的着色方式。
+	*/
+	enum class ShadingMode
+	{
+		Forward, // 前向着色：光栅化时每个通过深度测试的片段都立即着色，被覆盖的片段也会着色
+		Deferred // 延迟着色：光栅化时只记录可见性缓冲区，绘制结束后每个可见的像素（或采样点）只着色一次
+	};
+	/**
+
+	@brief 枚举类，表示按朝向剔除哪些三角形。
+	*/
+	enum class CullMode
+	{
+		None,  // 不按朝向剔除
+		Back,  // 剔除背面
+		Front  // 剔除正面
+	};
+	/**
+
+	@brief 枚举类，表示正面三角形在屏幕上的绕序。
+	*/
+	enum class FrontFace
+	{
+		CounterClockwise, // 逆时针为正面（OBJ 模型的惯例）
+		Clockwise         // 顺时针为正面
+	};
+	/**
+
+	@brief 一次 draw 中各个阶段处理和丢弃的三角形数量。按 meshlet 绘制时，整块剔除的 meshlet 中的三角形
+	也计入 input，并分别计入 frustum 和 backface。
+	*/
+	struct CullStats
+	{
+		int input = 0; // 提交的三角形数
+		int frustum = 0; // 完全在屏幕外或近平面后面而被丢弃的三角形数
+		int clipped = 0; // 需要做齐次裁剪的三角形数
+		int backface = 0; // 按朝向剔除的三角形数
+		int degenerate = 0; // 面积为 0 或坐标不是有限值的三角形数
+		int micro = 0; // 包围盒内没有任何采样点、不可能覆盖采样点的小三角形数
+		int rasterized = 0; // 最终送去光栅化的三角形数（裁剪拆分出的三角形分别计数）
+		int meshlets = 0; // 提交的 meshlet 数，不按 meshlet 绘制时为 0
+		int meshlet_frustum = 0; // 包围球完全在屏幕外或近平面后面而被整块丢弃的 meshlet 数
+		int meshlet_backface = 0; // 法向量锥表明全部三角形都会被按朝向剔除而被整块丢弃的 meshlet 数
+	};
+	/**
+
+	@brief 屏幕空间中的矩形像素区域，四个边界都是闭区间。
+	*/
+	struct Rect
+	{
+		int min_x, min_y;
+		int max_x, max_y;
+	};
+	/**
+
+	@brief 屏幕分块。分块阶段把覆盖该块的三角形编号按提交顺序记录下来，光栅化阶段每个分块由一个线程独占处理。
+	*/
+	struct Tile
+	{
+		Rect rect; // 分块覆盖的像素区域
+		std::vector<int> triangles; // 覆盖该分块的三角形编号，保持提交顺序
+	};
+	/**
+
+	@brief 枚举类，表示超采样缓冲区的抗锯齿方式。
+	*/
+	enum class AntiAliasing
+	{
+		SSAA, // 超采样：每个通过深度测试的采样点都单独调用片段着色器
+		MSAA  // 多重采样：逐采样点做覆盖和深度测试，但每个像素对每个三角形只着色一次，结果写入所有通过测试的采样点
+	};
+	/**
+
+	@brief 枚举类，表示把超采样缓冲区解析到帧缓冲区时使用的重建滤波器。
+	*/
+	enum class ResolveFilter
+	{
+		Box,     // 盒式滤波：像素内所有采样点的平均值
+		Tent,    // 帐篷滤波：半径 1 个像素的双线性权重，会用到相邻像素的采样点，边缘更柔和
+		Gaussian // 高斯滤波：标准差 0.5 个像素，截断到 3x3 像素的邻域
+	};
+	/**
+
+	@brief 可见性缓冲区中的一个采样点：当前可见的三角形编号和该点的重心坐标，延迟着色时据此重建片段着色器的输入。
+	*/
+	struct VisibilitySample
+	{
+		int triangle = -1; // 三角形在本次绘制中的编号，-1 表示本次绘制没有三角形写入该采样点
+		float bary[3]; // 重心坐标 alpha、beta、gamma
+	};
+	/**
+
+	@brief 分层深度（Hi-Z）。记录每个 8x8 像素块和每个 64x64 屏幕分块中已写入深度的最小值和最大值。
+	深度越大越靠近相机，所以最小值就是区域中最远的深度：三角形在区域内的最大深度都不超过它时，整个区域都被遮挡；
+	三角形在区域内的最小深度大于最大值时，区域内的深度测试一定通过。
+	*/
+	struct DepthPyramid
+	{
+		std::vector<float> block_min, block_max; // 每个像素块的深度范围，按行优先排列
+		std::vector<float> tile_min, tile_max; // 每个屏幕分块的深度范围，与 rasterizer 中的分块一一对应
+
+		/**
+		 * @brief 把所有深度范围重置为清空后的深度缓冲区（负无穷大）。
+		 */
+		void reset()
+		{
+			for (auto* v : { &block_min, &block_max, &tile_min, &tile_max }) {
+				std::fill(v->begin(), v->end(), -std::numeric_limits<float>::infinity());
+			}
+		}
+	};
+	/**
+
 	@brief 渲染器类负责将 3D 场景渲染到 2D 帧缓冲区中。
 	*/
 	class rasterizer
@@ -52,11 +175,114 @@ namespace rst {
 		int width; // 帧缓冲区的宽度。
 		int height; // 帧缓冲区的高度。
 
-		std::optional<Texture> texture; // 用于纹理映射的纹理。
+		int sample_count; // 超采样缓冲区中每个像素的采样点数。
+		SamplePattern sample_pattern; // 采样点的分布方式。
+		const SamplePoint* sample_positions; // 采样点位置表，长度为 sample_count，构造时选定。
+
+		std::shared_ptr<const Texture> texture; // 用于纹理映射的纹理，与其他光栅化器共享，不拷贝纹素。
+		Sampler sampler; // 与 texture 一起绑定的采样器状态，属于这个光栅化器，不随纹理共享。
 
 		std::function<Vec3f(fragment_shader_payload)> fragmentShader; // 用于着色像素的片段着色器函数。
 		std::function<Vec3f(vertex_shader_payload)> vertexShader; // 用于变换顶点的顶点着色器函数。
 
+		static constexpr int tile_size = 64; // 屏幕分块的边长（像素）。
+		static constexpr int block_size = 8; // 分块内分层遍历时像素块的边长（像素），与批量内核的 lane 数相同。
+		static constexpr float near_w = 1e-5f; // 近裁剪平面 w = near_w，w 不大于 0 的顶点在相机后面，透视除法没有意义。
+		static constexpr float guard_band = 1024.f; // 保护带宽度（像素）。顶点超出屏幕不超过这个距离时不裁剪，直接交给包围盒裁剪处理。
+		std::vector<Tile> tiles; // 屏幕分块，按行优先排列。
+		int tiles_x; // 每行的屏幕分块数。
+		int blocks_x; // 每行的像素块数。
+		DepthPyramid hiz; // depth_buffer 的分层深度。
+		DepthPyramid super_hiz; // super_depth_buffer 的分层深度，统计像素块中所有采样点。
+		std::unique_ptr<ThreadPool> pool; // 光栅化分块所用的线程池。
+
+		SimdLevel simd_level; // 光栅化批量内核使用的指令集级别。
+		BlockKernel block_kernel; // 光栅化批量内核，一次完成 8 个采样点的覆盖与深度测试。
+		ResolveKernel resolve_kernel; // 超采样解析的加权求和内核。
+		VertexKernel vertex_kernel; // 顶点处理阶段的批量变换内核。
+
+		VertexStream vertices; // 最近一次 draw 的顶点流。
+		std::vector<unsigned> vertex_outcodes; // 顶点流中每个顶点在哪些裁剪平面外侧的位掩码。
+
+		std::vector<Triangle> screen_triangles; // 经过视口变换后的三角形，供分块光栅化使用。
+		std::vector<std::array<Vec3f, 3>> view_positions; // 与 screen_triangles 一一对应的视图空间顶点坐标。
+		std::vector<uint32_t> meshlet_vertices; // 按 meshlet 绘制时，顶点流中每个顶点在网格中的编号。
+		std::vector<int> meshlet_indices; // 按 meshlet 绘制时，未被剔除的三角形的顶点在顶点流中的编号，每个三角形三个。
+
+		ShadingMode shading_mode = ShadingMode::Forward; // 当前绘制的着色方式。
+		CullMode cull_mode = CullMode::None; // 按朝向剔除的方式。
+		FrontFace front_face = FrontFace::CounterClockwise; // 正面三角形的绕序。
+		CullStats cull_stats; // 最近一次 draw 的剔除统计。
+		float lod_threshold = 1.f; // 选择 LOD 时允许的最大屏幕空间误差（像素）。
+		AntiAliasing antialiasing = AntiAliasing::MSAA; // 超采样光栅化的抗锯齿方式。
+		std::vector<VisibilitySample> visibility_buffer; // 可见性缓冲区，与正在使用的深度缓冲区按同样的方式索引，第一次延迟着色时才分配。
+
+		/**
+
+		@brief 把 screen_triangles 中的三角形按包围盒分配到各个屏幕分块中，分块内保持提交顺序。
+		包围盒跨越多个分块时，用边函数对每个分块做整体测试，与三角形不相交的分块不会收到该三角形。
+		*/
+		void bin_triangles();
+
+		/**
+
+		@brief 剔除阶段，在视口变换之后对每个三角形执行一次，同时更新 cull_stats。
+		按屏幕空间有向面积的符号判断朝向；面积为 0 的三角形是退化的；
+		包围盒内既没有像素中心也没有任何采样点时，三角形不可能通过覆盖测试，也直接丢弃。
+		@param t 屏幕空间中的三角形。
+		@return 三角形被剔除时返回 true。
+		*/
+		bool cull_triangle(const Triangle& t);
+
+		/**
+
+		@brief 根据重心坐标插值三角形的顶点属性，构造片段着色器的输入并调用片段着色器。
+		@param t 屏幕空间中的三角形。
+		@param view_pos 三角形的三个顶点在视口坐标系中的坐标。
+		@param alpha 顶点 0 的重心坐标。
+		@param beta 顶点 1 的重心坐标。
+		@param gamma 顶点 2 的重心坐标。
+		@return 片段着色器输出的颜色。
+		*/
+		Vec3f shade_fragment(const Triangle& t, const std::array<Vec3f, 3>& view_pos, float alpha, float beta, float gamma);
+
+		/**
+
+		@brief 延迟着色的解析阶段：按行并行遍历可见性缓冲区，每个可见的像素（超采样时是每个可见的采样点）只调用一次片段着色器，
+		解析完的采样点同时重置为未写入，供下一次延迟绘制使用。超采样时只写采样点的颜色，帧缓冲区由 resolve 统一生成。
+		@param super 为 true 时可见性缓冲区按超采样缓冲区索引，否则按帧缓冲区索引。
+		*/
+		void resolve_visibility(bool super);
+
+		/**
+
+		@brief 光栅化写入像素块后，从深度缓冲区重新统计该块的深度范围。
+		@param super 为 true 时统计 super_depth_buffer，否则统计 depth_buffer。
+		@param block_x 像素块左下角的x坐标。
+		@param block_y 像素块左下角的y坐标。
+		*/
+		void update_block_depth(bool super, int block_x, int block_y);
+
+		/**
+
+		@brief 两个 draw 重载的公共部分：变换顶点流，逐个三角形裁剪、剔除并提交，然后分块光栅化。
+		调用前顶点流中已经填好模型空间坐标。
+		@param triangle_count 三角形数。
+		@param assemble 组装三角形的函数，形如 void(int i, Triangle& tri, int index[3])：填写第 i 个三角形的法向量、
+		纹理坐标和颜色，并给出三个顶点在顶点流中的编号。tri.v 会被变换结果覆盖，不需要填写。
+		@param mode 本次绘制的着色方式。
+		*/
+		template <class Assemble>
+		void draw_primitives(int triangle_count, Assemble&& assemble, ShadingMode mode);
+
+		/**
+
+		@brief 从分块内所有像素块的深度范围重新统计屏幕分块的深度范围。
+		@param super 为 true 时更新 super_hiz，否则更新 hiz。
+		@param tile_rect 屏幕分块的像素区域。
+		*/
+		void update_tile_depth(bool super, const Rect& tile_rect);
+
 		/**
 
 		@brief 绘制两个点之间的直线。
@@ -64,27 +290,53 @@ namespace rst {
 		void draw_line();
 		/**
 
-		@brief 光栅化单个三角形。也就是要进行采样，可以采用包围盒采样或逐行检测采样，这里采用前者
+		@brief 光栅化单个三角形，不插值视图空间坐标（payload.view_pos 为零向量）。
 		@param t 要光栅化的三角形。
+		@param bounds 只光栅化该区域内的像素（通常是一个屏幕分块）。
 		*/
-		void rasterizer_triangle(Triangle& t);
+		void rasterizer_triangle(Triangle& t, const Rect& bounds);
 
 		/**
 
-		@brief 光栅化单个三角形。也就是要进行采样，可以采用包围盒采样或逐行检测采样，这里采用前者
+		@brief 超采样光栅化单个三角形，不插值视图空间坐标（payload.view_pos 为零向量）。
 		@param t 要光栅化的三角形。
+		@param bounds 只光栅化该区域内的像素（通常是一个屏幕分块）。
 		*/
-		void rasterizer_triangle_msaa(Triangle& t, int sample_count);
+		void rasterizer_triangle_msaa(Triangle& t, const Rect& bounds);
 
 		/**
 		* @brief 光栅化单个三角形。也就是要进行采样，可以采用包围盒采样或逐行检测采样，这里采用前者。
+		* 包围盒按 8x8 像素块分层遍历：完全在三角形外的块直接跳过，完全在三角形内的块不做覆盖测试。
+		* 分层深度先在分块和像素块两级剔除被已绘制几何完全遮挡的三角形，不需要读取逐像素的深度缓冲区。
+		* 块中每一行的 8 个像素交给批量内核完成覆盖和深度测试（early-Z），只有通过测试的像素才插值属性并着色。
+		* 延迟着色时不调用片段着色器，而是把三角形编号和重心坐标写入可见性缓冲区。
+		* @param t 要光栅化的三角形。
+		* @param view_pos 三角形的三个顶点在视口坐标系中的坐标。
+		* @param triangle_id 三角形在 screen_triangles 中的编号，延迟着色时写入可见性缓冲区。
+		* @param bounds 只光栅化该区域内的像素（通常是一个屏幕分块）。
+		*/
+		void rasterizer_triangle_new(Triangle& t, const std::array<Vec3f, 3>& view_pos, int triangle_id, const Rect& bounds);
+
+		/**
+		* @brief 超采样光栅化单个三角形。包围盒按 8x8 像素块分层遍历，跳过完全在三角形外或被分层深度判定为完全遮挡的块，
+		* 每个像素的所有采样点按 8 个一组交给批量内核完成覆盖和深度测试，只有通过测试的采样点才插值属性并着色。
+		* SSAA 时每个通过测试的采样点单独着色；MSAA 时在这些采样点的质心处只着色一次，颜色写入全部这些采样点。
+		* 这里只写超采样缓冲区，不写帧缓冲区，像素颜色由一帧结束时的 resolve 统一求出。
+		* 延迟着色时不调用片段着色器，而是把三角形编号和重心坐标写入可见性缓冲区。
+		* 按构造时选定的采样点数分派到对应的 rasterizer_triangle_msaa_impl。
 		* @param t 要光栅化的三角形。
 		* @param view_pos 三角形的三个顶点在视口坐标系中的坐标。
-		* 		
+		* @param triangle_id 三角形在 screen_triangles 中的编号，延迟着色时写入可见性缓冲区。
+		* @param bounds 只光栅化该区域内的像素（通常是一个屏幕分块）。
 		*/
-		void rasterizer_triangle_new(Triangle& t, std::vector<Vec3f> view_pos);
+		void rasterizer_triangle_msaa_new(Triangle& t, const std::array<Vec3f, 3>& view_pos, int triangle_id, const Rect& bounds);
 
-		void rasterizer_triangle_msaa_new(Triangle& t, std::vector<Vec3f> view_pos, int sample_count);
+		/**
+		* @brief rasterizer_triangle_msaa_new 的实现，采样点数是模板参数，逐采样点的循环在编译期展开。
+		* @tparam Samples 每个像素的采样点数，必须等于 sample_count。
+		*/
+		template <int Samples>
+		void rasterizer_triangle_msaa_impl(Triangle& t, const std::array<Vec3f, 3>& view_pos, int triangle_id, const Rect& bounds);
 	public:
 		std::vector<Vec3f> frame_buffer; // 存储像素颜色的帧缓冲区。
 		std::vector<Vec3f> super_frame_buffer; // 用于超采样的帧缓冲区。
@@ -93,15 +345,11 @@ namespace rst {
 		 * @brief 构造函数，创建指定宽度和高度的渲染器对象。
 		 * @param w 帧缓冲区的宽度。
 		 * @param h 帧缓冲区的高度。
-		 * @param sample_count 采样点数目的平方根。默认是2。例如，如果sample_count是2，则将生成4个采样点。
-		 */
-		rasterizer(int w, int h, int sample_count = 2) : width(w), height(h) {
-			frame_buffer.resize(w * h);
-			depth_buffer.resize(w * h);
-			super_frame_buffer.resize(w * h * sample_count * sample_count);
-			super_depth_buffer.resize(w * h * sample_count * sample_count);
-			texture = std::nullopt;
-		}
+		 * @param sample_count 超采样时每个像素的采样点数，可以是 1、2、4、8 或 16，默认是4。其它值会退化为不超过它的最大受支持值。
+		 * @param thread_count 光栅化使用的线程数。默认是0，表示使用硬件并发数；为1时退化为串行光栅化。
+		 * @param pattern 采样点的分布方式。默认是规则网格，4 个采样点时与旧版本的 2x2 超采样完全相同。
+		 */
+		rasterizer(int w, int h, int sample_count = 4, int thread_count = 0, SamplePattern pattern = SamplePattern::OrderedGrid);
 
 		/**
 		 * @brief 设置用于变换 3D 模型的模型矩阵。
@@ -122,10 +370,67 @@ namespace rst {
 		void set_projection(const Mat4f& p);
 
 		/**
-		 * @brief 设置用于纹理映射的纹理。
-		 * @param tex 纹理。
+		 * @brief 设置用于纹理映射的纹理。只保存句柄，同一张纹理可以同时绑定到多个光栅化器上，各个线程并发采样。
+		 * @param tex 纹理句柄，通常来自 AssetRegistry；为空时取消绑定。
+		 * @param tex_sampler 采样器状态，只对这个光栅化器有效，绑定同一张纹理的其他光栅化器可以使用不同的采样器。
+		 */
+		void set_texture(std::shared_ptr<const Texture> tex, const Sampler& tex_sampler = Sampler());
+
+		/**
+		 * @brief 指定光栅化批量内核和顶点变换内核使用的指令集级别。构造时已自动选择当前 CPU 支持的最高级别，
+		 * 这里主要用于对比不同实现的性能和结果。
+		 * @param level 指令集级别。
+		 */
+		void set_simd_level(SimdLevel level);
+
+		/**
+		 * @brief 指定超采样光栅化的抗锯齿方式，默认是 MSAA。SSAA 着色次数是 MSAA 的采样点数倍，主要用于对比画质和性能。
+		 * @param mode 抗锯齿方式。
+		 */
+		void set_antialiasing(AntiAliasing mode);
+
+		/**
+		 * @brief 指定按朝向剔除哪些三角形，默认不剔除。封闭模型的背面总会被正面挡住，剔除背面可以省去约一半的光栅化。
+		 * @param mode 剔除方式。
 		 */
-		void set_texture(Texture tex);
+		void set_cull_mode(CullMode mode);
+
+		/**
+		 * @brief 指定正面三角形在屏幕上的绕序，默认逆时针为正面。
+		 * @param face 正面的绕序。
+		 */
+		void set_front_face(FrontFace face);
+
+		/**
+		 * @brief 指定选择 LOD 时允许的最大屏幕空间误差，默认是 1 个像素。阈值越大，越早切换到更粗的 LOD。
+		 * @param pixels 误差阈值（像素）。
+		 */
+		void set_lod_threshold(float pixels);
+
+		/**
+		 * @brief 按当前的 MVP 矩阵和视口估计网格在屏幕上的大小，选出误差投影到屏幕上不超过阈值的最粗的 LOD。
+		 * 用包围盒的外接球估计：在外接球上离相机最近的深度处，模型空间的单位长度在屏幕上大约对应多少像素。
+		 * 外接球跨过相机所在平面时无法估计，总是选择原始网格。
+		 * @param mesh 原始网格（第 0 级）。
+		 * @param lods build_lod_chain 生成的 LOD 链。
+		 * @return 选中的级别，0 表示原始网格，i 表示 lods[i - 1]。
+		 */
+		int select_lod(const Mesh& mesh, const std::vector<MeshLod>& lods);
+
+		/**
+		 * @brief 求经过屏幕上一点的射线，用于拾取：与模型的 Bvh::intersect 配合，就能知道鼠标下是哪个三角形。
+		 * 射线在模型空间中，方向已归一化，t 就是模型空间中的距离。透视投影时从近平面出发、朝远离相机的方向；
+		 * 投影矩阵不含透视（w 与位置无关）时射线覆盖整条直线，t_min 是负的最大浮点数。
+		 * @param x 屏幕坐标，与光栅化相同，原点在左下角，像素中心在 x + 0.5。
+		 * @param y 屏幕坐标。
+		 * @return 模型空间中的射线。
+		 */
+		Ray screen_ray(float x, float y);
+
+		/**
+		 * @brief 返回最近一次 draw 的剔除统计。
+		 */
+		const CullStats& get_cull_stats() const { return cull_stats; }
 
 		/**
 		 * @brief 清除指定的缓冲区。
@@ -163,14 +468,70 @@ namespace rst {
 		 * @brief 3D 渲染管线中的顶点变换和光栅化阶段，主要实现了将三维模型的顶点数据转换为屏幕坐标
 		 *
 		 * 该函数会遍历 TriangleList 中的每个三角形，对每个三角形进行逐像素的光栅化，从而将三角形绘制到帧缓冲区中。
+		 * 透视除法之前先做裁剪：完全在屏幕外或近平面后面的三角形直接丢弃；有顶点在近平面后面或超出保护带时，
+		 * 在齐次裁剪空间中裁剪成凸多边形再拆成三角形；其余三角形（包括大多数与屏幕边缘相交的）不需要裁剪。
+		 * 视口变换之后再按朝向、退化和不覆盖任何采样点剔除三角形，各阶段的数量记录在 get_cull_stats 中。
+		 * 变换后的三角形先按包围盒分配到 64x64 的屏幕分块中，再由线程池并行光栅化各个分块。
+		 * 每个像素只属于一个分块，分块内按提交顺序处理三角形，所以结果与串行光栅化逐位一致。
 		 * MVP 矩阵的计算：将模型坐标系的三维坐标转换为裁剪空间的四维坐标。
 		 * 透视除法的实现：将裁剪空间的坐标除以齐次坐标 w，得到归一化设备坐标。
 		 * 视口变换的实现：将归一化设备坐标映射到屏幕坐标，并进行坐标系的转换。
 		 * 三角形光栅化的实现：根据三角形的顶点坐标，计算其内部的像素坐标，并进行像素着色。
 		 *
+		 * 延迟着色时光栅化阶段只写深度和可见性缓冲区，全部三角形光栅化完成后再按行并行解析，
+		 * 每个最终可见的像素只着色一次，得到的图像与前向着色相同。
+		 *
+		 * 超采样光栅化只写超采样缓冲区，一帧的所有 draw 完成后需要调用 resolve 才能得到 frame_buffer。
+		 *
 		 * @param TriangleList 要绘制的三角形列表。
+		 * @param mode 本次绘制的着色方式，默认是前向着色。
+		 */
+		void draw(std::vector<Triangle>& TriangleList, ShadingMode mode = ShadingMode::Forward);
+
+		/**
+		 * @brief 绘制索引网格。每个去重后的顶点只变换一次，三角形通过索引共享变换结果，其余流程与三角形列表相同。
+		 * @param mesh 要绘制的索引网格。
+		 * @param mode 本次绘制的着色方式，默认是前向着色。
+		 */
+		void draw(const Mesh& mesh, ShadingMode mode = ShadingMode::Forward);
+
+		/**
+		 * @brief 用 select_lod 选出的 LOD 绘制网格。网格在屏幕上越小，选中的级别越粗，顶点处理和三角形设置的开销越少。
+		 * @param mesh 原始网格。
+		 * @param lods 原始网格的 LOD 链，为空时等同于直接绘制原始网格。
+		 * @param mode 本次绘制的着色方式，默认是前向着色。
+		 */
+		void draw(const Mesh& mesh, const std::vector<MeshLod>& lods, ShadingMode mode = ShadingMode::Forward);
+
+		/**
+		 * @brief 按 meshlet 绘制索引网格。顶点处理之前先逐个 meshlet 剔除：包围球完全在近平面后面或某条屏幕边界外侧的，
+		 * 以及按朝向剔除时法向量锥表明其中所有三角形都朝向被剔除一侧的，整块丢弃。剩下的 meshlet 的局部顶点表拼成顶点流，
+		 * 只变换这些顶点，之后与绘制索引网格相同。两种剔除都是保守的，被丢弃的三角形逐个处理时也一定会被丢弃，
+		 * 所以画出的三角形与 draw(mesh) 相同，只是提交顺序按 meshlet 排列。
+		 * @param mesh 要绘制的索引网格。
+		 * @param meshlets build_meshlets 对这个网格的切分结果，为空时等同于 draw(mesh)。
+		 * @param mode 本次绘制的着色方式，默认是前向着色。
+		 */
+		void draw(const Mesh& mesh, const MeshletSet& meshlets, ShadingMode mode = ShadingMode::Forward);
+
+		/**
+		 * @brief 用 select_lod 选出的 LOD 按 meshlet 绘制网格。
+		 * @param mesh 原始网格。
+		 * @param lods 原始网格的 LOD 链。
+		 * @param meshlets 每一级的 meshlet，meshlets[0] 对应原始网格，meshlets[i] 对应 lods[i - 1]；缺少某一级时该级按索引网格绘制。
+		 * @param mode 本次绘制的着色方式，默认是前向着色。
+		 */
+		void draw(const Mesh& mesh, const std::vector<MeshLod>& lods, const std::vector<MeshletSet>& meshlets, ShadingMode mode = ShadingMode::Forward);
+
+		/**
+		 * @brief 一帧结束时把超采样缓冲区解析到帧缓冲区，按行并行，每个像素只解析一次。
+		 *
+		 * 盒式滤波只用像素自身的采样点，结果与旧版本在光栅化时逐像素求平均完全相同；
+		 * 帐篷滤波和高斯滤波还会按距离加权相邻像素的采样点，屏幕边缘按最近的像素延伸。
+		 *
+		 * @param filter 重建滤波器，默认是盒式滤波。
 		 */
-		void draw(std::vector<Triangle>& TriangleList);
+		void resolve(ResolveFilter filter = ResolveFilter::Box);
 
 		/**
 		* @brief 生成超采样的采样点向量。
@@ -184,13 +545,12 @@ namespace rst {
 		 * @brief 计算超采样缓冲区中给定像素坐标的索引。
 		 * @param x 像素在 X 轴上的坐标。
 		 * @param y 像素在 Y 轴上的坐标。
-		 * @param sample_count 采样点数目的平方根。默认是2。例如，如果sample_count是2，则将生成4个采样点。
-		 * @return 超采样缓冲区中给定像素坐标的索引。
+		 * @return 超采样缓冲区中给定像素坐标的索引，该像素的 sample_count 个采样点从这里开始连续存放。
 		 */
-		int get_super_index(int x, int y, int sample_count = 2)
+		int get_super_index(int x, int y)
 		{
 			// 计算超采样缓冲区中给定像素坐标的索引。
-			return (height - 1 - y) * width * sample_count * sample_count + x * sample_count * sample_count;
+			return (height - 1 - y) * width * sample_count + x * sample_count;
 		}
 	};
 
@@ -0,0 +1,115 @@
+/**
+
+@file sample_pattern.h
+@brief 超采样/多重采样的采样点位置表。所有表都是编译期常量，渲染器构造时选定一张，光栅化时不再生成采样点。
+*/
+#pragma once
+
+namespace rst {
+
+	/**
+
+	@brief 采样点在像素内的位置，像素左下角为 (0, 0)，右上角为 (1, 1)。
+	*/
+	struct SamplePoint
+	{
+		float x, y;
+	};
+
+	/**
+
+	@brief 枚举类，表示采样点的分布方式。
+	*/
+	enum class SamplePattern
+	{
+		OrderedGrid, // 规则网格，与旧的 getSuperSampleStep 顺序相同（先按 x 再按 y）
+		RotatedGrid, // 旋转网格，每一行、每一列都只有一个采样点，对接近水平和竖直的边抗锯齿效果更好
+		Standard     // D3D 标准多重采样位置
+	};
+
+	/**
+
+	@brief 支持的最大采样点数。
+	*/
+	constexpr int max_samples = 16;
+
+	namespace sample_tables {
+
+		// D3D 标准采样位置以 1/16 像素为单位、相对像素中心给出，y 轴向下，这里换算到本渲染器的像素坐标
+		constexpr SamplePoint standard(int dx, int dy) { return { 0.5f + dx / 16.f, 0.5f - dy / 16.f }; }
+
+		constexpr SamplePoint center[1] = { { 0.5f, 0.5f } };
+
+		constexpr SamplePoint ordered2[2] = { { 0.25f, 0.5f }, { 0.75f, 0.5f } };
+		constexpr SamplePoint ordered4[4] = { { 0.25f, 0.25f }, { 0.25f, 0.75f }, { 0.75f, 0.25f }, { 0.75f, 0.75f } };
+		constexpr SamplePoint ordered8[8] = {
+			{ 0.125f, 0.25f }, { 0.125f, 0.75f }, { 0.375f, 0.25f }, { 0.375f, 0.75f },
+			{ 0.625f, 0.25f }, { 0.625f, 0.75f }, { 0.875f, 0.25f }, { 0.875f, 0.75f }
+		};
+		constexpr SamplePoint ordered16[16] = {
+			{ 0.125f, 0.125f }, { 0.125f, 0.375f }, { 0.125f, 0.625f }, { 0.125f, 0.875f },
+			{ 0.375f, 0.125f }, { 0.375f, 0.375f }, { 0.375f, 0.625f }, { 0.375f, 0.875f },
+			{ 0.625f, 0.125f }, { 0.625f, 0.375f }, { 0.625f, 0.625f }, { 0.625f, 0.875f },
+			{ 0.875f, 0.125f }, { 0.875f, 0.375f }, { 0.875f, 0.625f }, { 0.875f, 0.875f }
+		};
+
+		// 旋转网格：4 个采样点是常见的 RGSS，8 和 16 个采样点分别取 y = 3x (mod 8) 和 y = 5x (mod 16) 的格点
+		constexpr SamplePoint rotated2[2] = { { 0.25f, 0.25f }, { 0.75f, 0.75f } };
+		constexpr SamplePoint rotated4[4] = { { 0.375f, 0.125f }, { 0.875f, 0.375f }, { 0.125f, 0.625f }, { 0.625f, 0.875f } };
+		constexpr SamplePoint rotated8[8] = {
+			{ 0.0625f, 0.0625f }, { 0.1875f, 0.4375f }, { 0.3125f, 0.8125f }, { 0.4375f, 0.1875f },
+			{ 0.5625f, 0.5625f }, { 0.6875f, 0.9375f }, { 0.8125f, 0.3125f }, { 0.9375f, 0.6875f }
+		};
+		constexpr SamplePoint rotated16[16] = {
+			{ 0.03125f, 0.03125f }, { 0.09375f, 0.34375f }, { 0.15625f, 0.65625f }, { 0.21875f, 0.96875f },
+			{ 0.28125f, 0.28125f }, { 0.34375f, 0.59375f }, { 0.40625f, 0.90625f }, { 0.46875f, 0.21875f },
+			{ 0.53125f, 0.53125f }, { 0.59375f, 0.84375f }, { 0.65625f, 0.15625f }, { 0.71875f, 0.46875f },
+			{ 0.78125f, 0.78125f }, { 0.84375f, 0.09375f }, { 0.90625f, 0.40625f }, { 0.96875f, 0.71875f }
+		};
+
+		constexpr SamplePoint standard2[2] = { standard(4, 4), standard(-4, -4) };
+		constexpr SamplePoint standard4[4] = { standard(-2, -6), standard(6, -2), standard(-6, 2), standard(2, 6) };
+		constexpr SamplePoint standard8[8] = {
+			standard(1, -3), standard(-1, 3), standard(5, 1), standard(-3, -5),
+			standard(-5, 5), standard(-7, -1), standard(3, 7), standard(7, -7)
+		};
+		constexpr SamplePoint standard16[16] = {
+			standard(1, 1), standard(-1, -3), standard(-3, 2), standard(4, -1),
+			standard(-5, -2), standard(2, 5), standard(5, 3), standard(3, -5),
+			standard(-2, 6), standard(0, -7), standard(-4, -6), standard(-6, 4),
+			standard(-8, 0), standard(7, -4), standard(6, 7), standard(-7, -8)
+		};
+
+	} // namespace sample_tables
+
+	/**
+
+	@brief 判断采样点数是否受支持（1、2、4、8 或 16）。
+	*/
+	constexpr bool is_supported_sample_count(int count)
+	{
+		return count == 1 || count == 2 || count == 4 || count == 8 || count == 16;
+	}
+
+	/**
+
+	@brief 返回指定分布方式和采样点数的采样点位置表。
+	@param pattern 采样点的分布方式。
+	@param count 采样点数，必须是 1、2、4、8 或 16。
+	@return 长度为 count 的采样点数组；采样点数不受支持时返回 nullptr。
+	*/
+	constexpr const SamplePoint* sample_points(SamplePattern pattern, int count)
+	{
+		using namespace sample_tables;
+		if (count == 1) return center;
+		switch (pattern) {
+		case SamplePattern::OrderedGrid:
+			return count == 2 ? ordered2 : count == 4 ? ordered4 : count == 8 ? ordered8 : count == 16 ? ordered16 : nullptr;
+		case SamplePattern::RotatedGrid:
+			return count == 2 ? rotated2 : count == 4 ? rotated4 : count == 8 ? rotated8 : count == 16 ? rotated16 : nullptr;
+		default:
+			return count == 2 ? standard2 : count == 4 ? standard4 : count == 8 ? standard8 : count == 16 ? standard16 : nullptr;
+		}
+	}
+
+} // namespace rst
@@ -0,0 +1,22 @@
+/**
+
+@file simd_target.h
+@brief 各模块共用的 SIMD 编译环境：x86 上定义 RST_X86 并引入 intrinsics 头文件，以及给单个函数开启 AVX 的 RST_TARGET_AVX。
+运行时选择哪一级实现见 raster_kernel.h 中的 SimdLevel 和 detect_simd_level。
+*/
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RST_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC 允许在任意函数中使用 AVX 指令；GCC/Clang 需要给函数单独开启目标指令集
+#if defined(RST_X86) && !defined(_MSC_VER)
+#define RST_TARGET_AVX __attribute__((target("avx")))
+#else
+#define RST_TARGET_AVX
+#endif
@@ -3,7 +3,70 @@
 #include <string.h>
 #include <time.h>
 #include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
 #include "tgaimage.h"
+#include "mapped_file.h"
+#include "simd_target.h"
+
+namespace {
+
+    // 最低的置位的位置，mask 不为 0
+    inline int lowest_bit(unsigned mask) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // 在一行像素中从 first 开始比较每个像素和它后一个像素，返回第一个“与后一个像素相同”等于 equal 的像素，
+    // 没有时返回 last。last 必须小于行宽，保证后一个像素存在
+    int scan_pixels(const unsigned char* line, int first, int last, int bytespp, bool equal) {
+        int i = first;
+#ifdef RST_X86
+        // 一次比较 16 个字节与后移一个像素的 16 个字节，逐字节相等的掩码中，像素的 bytespp 个位都置位才说明像素相同。
+        // pixel_bits 标出每个像素的第一个字节，每次前进 16 / bytespp 个完整的像素
+        const int step = 16 / bytespp;
+        const unsigned pixel_bits = bytespp == 1 ? 0xFFFF : (bytespp == 2 ? 0x5555 : (bytespp == 3 ? 0x1249 : 0x1111));
+        for (; (i + 1) * bytespp + 16 <= (last + 1) * bytespp; i += step) {
+            const unsigned char* p = line + i * bytespp;
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + bytespp));
+            const unsigned bytes_equal = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+            unsigned pixels_equal = bytes_equal;
+            for (int k = 1; k < bytespp; k++) pixels_equal &= bytes_equal >> k;
+            const unsigned hits = (equal ? pixels_equal : ~pixels_equal) & pixel_bits;
+            if (hits) return i + lowest_bit(hits) / bytespp;
+        }
+#endif
+        for (; i < last; i++) {
+            if ((memcmp(line + i * bytespp, line + (i + 1) * bytespp, bytespp) == 0) == equal) return i;
+        }
+        return last;
+    }
+
+    // 把一个像素重复写 count 次
+    void fill_pixels(unsigned char* dst, const unsigned char* pixel, size_t count, int bytespp) {
+        if (bytespp == 1) {
+            memset(dst, pixel[0], count);
+            return;
+        }
+        // 先写一个像素，之后每次把已经写好的部分整体拷贝一份，拷贝次数是 count 的对数
+        const size_t total = count * bytespp;
+        memcpy(dst, pixel, bytespp);
+        size_t filled = bytespp;
+        while (filled < total) {
+            const size_t n = std::min(filled, total - filled);
+            memcpy(dst + filled, dst, n);
+            filled += n;
+        }
+    }
+
+} // namespace
 
 TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0) {
 }
@@ -20,6 +83,11 @@ TGAImage::TGAImage(const TGAImage& img) : data(NULL), width(img.width), height(i
     memcpy(data, img.data, nbytes);
 }
 
+TGAImage::TGAImage(TGAImage&& img) noexcept : data(img.data), width(img.width), height(img.height), bytespp(img.bytespp) {
+    img.data = NULL;
+    img.width = img.height = img.bytespp = 0;
+}
+
 TGAImage::~TGAImage() {
     if (data) delete[] data;
 }
@@ -37,50 +105,65 @@ TGAImage& TGAImage::operator =(const TGAImage& img) {
     return *this;
 }
 
+TGAImage& TGAImage::operator =(TGAImage&& img) noexcept {
+    if (this != &img) {
+        if (data) delete[] data;
+        data = img.data;
+        width = img.width;
+        height = img.height;
+        bytespp = img.bytespp;
+        img.data = NULL;
+        img.width = img.height = img.bytespp = 0;
+    }
+    return *this;
+}
+
 bool TGAImage::read_tga_file(const char* filename) {
     if (data) delete[] data;
     data = NULL;
-    std::ifstream in;
-    in.open(filename, std::ios::binary);
-    if (!in.is_open()) {
+    // 整个文件映射到内存中，文件头和RLE压缩的像素直接从映射区域解析，不经过流
+    MappedFile file(filename);
+    if (!file.is_open()) {
         std::cerr << "can't open file " << filename << "\n";
-        in.close();
         return false;
     }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file.data());
     TGA_Header header;
-    in.read((char*)&header, sizeof(header));
-    if (!in.good()) {
-        in.close();
+    if (file.size() < sizeof(header)) {
         std::cerr << "an error occured while reading the header\n";
         return false;
     }
+    memcpy(&header, bytes, sizeof(header));
     width = header.width;
     height = header.height;
     bytespp = header.bitsperpixel >> 3;
     if (width <= 0 || height <= 0 || (bytespp != GRAYSCALE && bytespp != RGB && bytespp != RGBA)) {
-        in.close();
         std::cerr << "bad bpp (or width/height) value\n";
         return false;
     }
-    unsigned long nbytes = bytespp * width * height;
+    // 跳过图像 ID 和调色板，像素数据紧随其后
+    size_t offset = sizeof(header) + static_cast<unsigned char>(header.idlength);
+    if (header.colormaptype == 1) {
+        offset += static_cast<size_t>(static_cast<unsigned short>(header.colormaplength)) * ((static_cast<unsigned char>(header.colormapdepth) + 7) / 8);
+    }
+    const size_t nbytes = static_cast<size_t>(bytespp) * width * height;
+    const size_t available = file.size() > offset ? file.size() - offset : 0;
     data = new unsigned char[nbytes];
     if (3 == header.datatypecode || 2 == header.datatypecode) {
-        in.read((char*)data, nbytes);
-        if (!in.good()) {
-            in.close();
+        // 未压缩的像素用一次 read 直接读进缓冲区，比从映射区域拷贝少一遍缺页
+        std::ifstream in(filename, std::ios::binary);
+        if (available < nbytes || !in.seekg(static_cast<std::streamoff>(offset)) || !in.read((char*)data, static_cast<std::streamsize>(nbytes))) {
             std::cerr << "an error occured while reading the data\n";
             return false;
         }
     }
     else if (10 == header.datatypecode || 11 == header.datatypecode) {
-        if (!load_rle_data(in)) {
-            in.close();
+        if (!load_rle_data(bytes + offset, available)) {
             std::cerr << "an error occured while reading the data\n";
             return false;
         }
     }
     else {
-        in.close();
         std::cerr << "unknown file format " << (int)header.datatypecode << "\n";
         return false;
     }
@@ -91,57 +174,45 @@ bool TGAImage::read_tga_file(const char* filename) {
         flip_horizontally();
     }
     std::cerr << width << "x" << height << "/" << bytespp * 8 << "\n";
-    in.close();
     return true;
 }
 
-bool TGAImage::load_rle_data(std::ifstream& in) {
-    unsigned long pixelcount = width * height;
-    unsigned long currentpixel = 0;
-    unsigned long currentbyte = 0;
-    TGAColor colorbuffer;
-    do {
-        unsigned char chunkheader = 0;
-        chunkheader = in.get();
-        if (!in.good()) {
+bool TGAImage::load_rle_data(const unsigned char* src, size_t size) {
+    const size_t nbytes = static_cast<size_t>(width) * height * bytespp;
+    size_t in = 0;
+    size_t currentbyte = 0;
+    while (currentbyte < nbytes) {
+        if (in >= size) {
             std::cerr << "an error occured while reading the data\n";
             return false;
         }
+        const unsigned char chunkheader = src[in++];
+        const size_t count = (chunkheader & 0x7F) + 1; // 包中的像素数
+        const size_t chunkbytes = count * bytespp;
+        if (currentbyte + chunkbytes > nbytes) {
+            std::cerr << "Too many pixels read\n";
+            return false;
+        }
         if (chunkheader < 128) {
-            chunkheader++;
-            for (int i = 0; i < chunkheader; i++) {
-                in.read((char*)colorbuffer.bgra, bytespp);
-                if (!in.good()) {
-                    std::cerr << "an error occured while reading the header\n";
-                    return false;
-                }
-                for (int t = 0; t < bytespp; t++)
-                    data[currentbyte++] = colorbuffer.bgra[t];
-                currentpixel++;
-                if (currentpixel > pixelcount) {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
-                }
+            // 原始包：count 个像素原样存放
+            if (size - in < chunkbytes) {
+                std::cerr << "an error occured while reading the header\n";
+                return false;
             }
+            memcpy(data + currentbyte, src + in, chunkbytes);
+            in += chunkbytes;
         }
         else {
-            chunkheader -= 127;
-            in.read((char*)colorbuffer.bgra, bytespp);
-            if (!in.good()) {
+            // 行程包：一个像素重复 count 次
+            if (size - in < static_cast<size_t>(bytespp)) {
                 std::cerr << "an error occured while reading the header\n";
                 return false;
             }
-            for (int i = 0; i < chunkheader; i++) {
-                for (int t = 0; t < bytespp; t++)
-                    data[currentbyte++] = colorbuffer.bgra[t];
-                currentpixel++;
-                if (currentpixel > pixelcount) {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
-                }
-            }
+            fill_pixels(data + currentbyte, src + in, count, bytespp);
+            in += bytespp;
         }
-    } while (currentpixel < pixelcount);
+        currentbyte += chunkbytes;
+    }
     return true;
 }
 
@@ -170,7 +241,7 @@ bool TGAImage::write_tga_file(const char* filename, bool rle) {
         return false;
     }
     if (!rle) {
-        out.write((char*)data, width * height * bytespp);
+        out.write((char*)data, static_cast<std::streamsize>(width) * height * bytespp);
         if (!out.good()) {
             std::cerr << "can't unload raw data\n";
             out.close();
@@ -185,17 +256,7 @@ bool TGAImage::write_tga_file(const char* filename, bool rle) {
         }
     }
     out.write((char*)developer_area_ref, sizeof(developer_area_ref));
-    if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
-        out.close();
-        return false;
-    }
     out.write((char*)extension_area_ref, sizeof(extension_area_ref));
-    if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
-        out.close();
-        return false;
-    }
     out.write((char*)footer, sizeof(footer));
     if (!out.good()) {
         std::cerr << "can't dump the tga file\n";
@@ -206,52 +267,43 @@ bool TGAImage::write_tga_file(const char* filename, bool rle) {
     return true;
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
 bool TGAImage::unload_rle_data(std::ofstream& out) {
-    const unsigned char max_chunk_length = 128;
-    unsigned long npixels = width * height;
-    unsigned long curpix = 0;
-    while (curpix < npixels) {
-        unsigned long chunkstart = curpix * bytespp;
-        unsigned long curbyte = curpix * bytespp;
-        unsigned char run_length = 1;
-        bool raw = true;
-        while (curpix + run_length < npixels && run_length < max_chunk_length) {
-            bool succ_eq = true;
-			/*for (int t = 0; succ_eq && t < bytespp; t++) {
-				succ_eq = (data[curbyte + t] == data[curbyte + t + bytespp]);
-			}*/
-            if (curpix % width != width - 1) {
-                for (int t = 0; succ_eq && t < bytespp; t++) {
-                    succ_eq = (data[curbyte + t] == data[curbyte + t + bytespp]);
-                }
-            }
-            else {
-                succ_eq = false;
-            }
-            curbyte += bytespp;
-            if (1 == run_length) {
-                raw = !succ_eq;
-            }
-            if (raw && succ_eq) {
-                run_length--;
-                break;
-            }
-            if (!raw && !succ_eq) {
-                break;
+    // 按扫描线编码，包不跨行。两个以上相同的像素编码成行程包，其余像素合并成原始包，
+    // 原始包在下一对相同像素之前结束。包最长 128 个像素。编码结果先攒在 packets 中，攒够一块再写入文件
+    const int max_chunk_length = 128;
+    const size_t flush_bytes = 1 << 20;
+    const size_t linebytes = static_cast<size_t>(width) * bytespp;
+    std::vector<unsigned char> packets;
+    packets.reserve(flush_bytes + linebytes + linebytes / max_chunk_length + 1);
+    for (int j = 0; j < height; j++) {
+        const unsigned char* line = data + j * linebytes;
+        int curpix = 0;
+        while (curpix < width) {
+            // 从 curpix 开始与后一个像素相同的像素一直延续到 run_end
+            const int run_end = scan_pixels(line, curpix, std::min(curpix + max_chunk_length - 1, width - 1), bytespp, false);
+            const int run_length = run_end - curpix + 1;
+            if (run_length >= 2) {
+                packets.push_back(static_cast<unsigned char>(run_length + 127));
+                packets.insert(packets.end(), line + curpix * bytespp, line + (curpix + 1) * bytespp);
+                curpix += run_length;
+                continue;
             }
-            run_length++;
+            // 原始包延续到下一对相同像素之前；找不到时延续到包长上限或行尾
+            const int limit = std::min(curpix + max_chunk_length, width);
+            const int search_end = std::min(limit, width - 1);
+            const int raw_end = scan_pixels(line, curpix + 1, search_end, bytespp, true);
+            const int raw_length = (raw_end < search_end ? raw_end : limit) - curpix;
+            packets.push_back(static_cast<unsigned char>(raw_length - 1));
+            packets.insert(packets.end(), line + curpix * bytespp, line + (curpix + raw_length) * bytespp);
+            curpix += raw_length;
         }
-        curpix += run_length;
-        out.put(raw ? run_length - 1 : run_length + 127);
-        if (!out.good()) {
-            std::cerr << "can't dump the tga file\n";
-            return false;
-        }
-        out.write((char*)(data + chunkstart), (raw ? run_length * bytespp : bytespp));
-        if (!out.good()) {
-            std::cerr << "can't dump the tga file\n";
-            return false;
+        if (packets.size() >= flush_bytes || j == height - 1) {
+            out.write((const char*)packets.data(), static_cast<std::streamsize>(packets.size()));
+            if (!out.good()) {
+                std::cerr << "can't dump the tga file\n";
+                return false;
+            }
+            packets.clear();
         }
     }
     return true;
@@ -365,4 +417,43 @@ bool TGAImage::scale(int w, int h) {
     width = w;
     height = h;
     return true;
-}
\ No newline at end of file
+}
+
+TGABenchmark benchmark_tga(int width, int height, int bytespp, bool rle, const char* path, int repeat) {
+    TGABenchmark result;
+    result.bytespp = bytespp;
+    result.rle = rle;
+    TGAImage image(width, height, bytespp);
+    unsigned char* pixels = image.buffer();
+    const size_t linebytes = static_cast<size_t>(width) * bytespp;
+    unsigned state = 1;
+    for (int j = 0; j < height; j++) {
+        unsigned char* line = pixels + j * linebytes;
+        for (int i = 0; i < width; i++) {
+            state = state * 1664525u + 1013904223u;
+            for (int k = 0; k < bytespp; k++) {
+                if (j < height / 2) line[i * bytespp + k] = static_cast<unsigned char>((i / 97 + j / 61) * (k + 1) * 37); // 纯色块
+                else line[i * bytespp + k] = static_cast<unsigned char>(i + j * (k + 1) + ((state >> (8 * k + 8)) & 7)); // 渐变加噪声
+            }
+        }
+    }
+    result.image_bytes = static_cast<size_t>(width) * height * bytespp;
+
+    TGAImage loaded;
+    for (int r = 0; r < std::max(repeat, 1); r++) {
+        auto start = std::chrono::steady_clock::now();
+        if (!image.write_tga_file(path, rle)) return result;
+        auto middle = std::chrono::steady_clock::now();
+        if (!loaded.read_tga_file(path)) return result;
+        auto end = std::chrono::steady_clock::now();
+        const double write_seconds = std::chrono::duration<double>(middle - start).count();
+        const double read_seconds = std::chrono::duration<double>(end - middle).count();
+        result.write_seconds = r == 0 ? write_seconds : std::min(result.write_seconds, write_seconds);
+        result.read_seconds = r == 0 ? read_seconds : std::min(result.read_seconds, read_seconds);
+    }
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    result.file_bytes = file.is_open() ? static_cast<size_t>(file.tellg()) : 0;
+    result.round_trip = loaded.get_width() == width && loaded.get_height() == height && loaded.get_bytespp() == bytespp
+        && memcmp(loaded.buffer(), pixels, result.image_bytes) == 0;
+    return result;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fstream>
+#include <cstddef>
 
 #pragma pack(push,1)
 struct TGA_Header {
@@ -70,8 +71,8 @@ protected:
     int height; // 图像高度
     int bytespp; // 每个像素占用的字节数
 
-    // 读取RLE压缩的图像数据
-    bool load_rle_data(std::ifstream& in);
+    // 从内存中解码RLE压缩的图像数据，src 是像素数据的起始位置，size 是之后剩余的字节数
+    bool load_rle_data(const unsigned char* src, size_t size);
 
     // 将图像数据写入到文件中，使用RLE压缩
     bool unload_rle_data(std::ofstream& out);
@@ -89,6 +90,9 @@ public:
     // 拷贝构造函数，复制另一个图像
     TGAImage(const TGAImage& img);
 
+    // 移动构造函数，接管另一个图像的缓冲区，不复制像素，被移动的图像变为空图像
+    TGAImage(TGAImage&& img) noexcept;
+
     // 从文件中读取TGA图像数据
     bool read_tga_file(const char* filename);
 
@@ -119,6 +123,9 @@ public:
     // 拷贝赋值，复制另一个图像
     TGAImage& operator =(const TGAImage& img);
 
+    // 移动赋值，释放自己的缓冲区并接管另一个图像的缓冲区
+    TGAImage& operator =(TGAImage&& img) noexcept;
+
     // 获取图像宽度
     int get_width();
 
@@ -133,4 +140,22 @@ public:
 
     // 清空图像数据缓冲区
     void clear();
-};
\ No newline at end of file
+};
+
+// TGA读写的性能测试结果
+struct TGABenchmark {
+    int bytespp = 0; // 每个像素占用的字节数
+    bool rle = false; // 是否使用RLE压缩
+    size_t image_bytes = 0; // 未压缩的像素字节数，吞吐量按它计算
+    size_t file_bytes = 0; // 文件大小
+    double write_seconds = 0; // 写入一次的最短耗时
+    double read_seconds = 0; // 读取一次的最短耗时
+    bool round_trip = false; // 读回的像素与写入的是否完全相同
+
+    double write_megabytes_per_second() const { return write_seconds > 0 ? image_bytes / (1024.0 * 1024.0) / write_seconds : 0; }
+    double read_megabytes_per_second() const { return read_seconds > 0 ? image_bytes / (1024.0 * 1024.0) / read_seconds : 0; }
+};
+
+// 生成一张测试图像写入 path 再读回，重复 repeat 次取最短耗时。图像上半部分是成片的纯色，下半部分是渐变加噪声，
+// RLE压缩时行程包和原始包都会出现
+TGABenchmark benchmark_tga(int width, int height, int bytespp, bool rle, const char* path, int repeat = 3);
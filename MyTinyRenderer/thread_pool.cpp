@@ -0,0 +1,94 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int thread_count) {
+    if (thread_count <= 0) {
+        thread_count = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    // 调用线程本身也参与计算，所以只需要额外创建 thread_count - 1 个工作线程
+    for (int i = 1; i < thread_count; i++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    task_cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return static_cast<int>(workers.size()) + 1;
+}
+
+void ThreadPool::run_items(const std::function<void(int)>& task, int count) {
+    for (int i = next_index++; i < count; i = next_index++) {
+        try {
+            task(i);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!first_error) first_error = std::current_exception();
+        }
+    }
+}
+
+void ThreadPool::worker_loop() {
+    unsigned long long seen = 0;
+    while (true) {
+        const std::function<void(int)>* task;
+        int count;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            task_cv.wait(lock, [&] { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+            task = job;
+            count = job_count;
+        }
+
+        run_items(*task, count);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (--pending_workers == 0) {
+            done_cv.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallel_for(int count, const std::function<void(int)>& task) {
+    if (count <= 0) return;
+
+    // 只有一个线程或只有一个子任务时直接串行执行，省去同步开销
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) task(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job = &task;
+        job_count = count;
+        next_index = 0;
+        pending_workers = static_cast<int>(workers.size());
+        first_error = nullptr;
+        generation++;
+    }
+    task_cv.notify_all();
+
+    run_items(task, count);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        done_cv.wait(lock, [&] { return pending_workers == 0; });
+        job = nullptr;
+        error = first_error;
+        first_error = nullptr;
+    }
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,77 @@
+/**
+
+@file thread_pool.h
+@brief 简单的常驻线程池，用于把互不相关的任务（例如屏幕分块）分发到多个核心上并行执行。
+*/
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+/**
+
+@brief 常驻线程池。工作线程在构造时创建，析构时回收，避免每次绘制都重新创建线程。
+*/
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers; // 工作线程（不包含调用 parallel_for 的线程本身）
+
+	std::mutex mtx; // 保护下面的任务状态
+	std::condition_variable task_cv; // 通知工作线程有新任务
+	std::condition_variable done_cv; // 通知调用线程所有工作线程已完成当前任务
+
+	const std::function<void(int)>* job = nullptr; // 当前任务
+	int job_count = 0; // 当前任务的子任务数量
+	std::atomic<int> next_index{ 0 }; // 下一个待领取的子任务编号
+	int pending_workers = 0; // 尚未完成当前任务的工作线程数量
+	unsigned long long generation = 0; // 任务代数，每次 parallel_for 加一
+	bool stop = false; // 析构时置为 true，通知工作线程退出
+	std::exception_ptr first_error; // 子任务抛出的第一个异常，在调用线程中重新抛出
+
+	/**
+	 * @brief 工作线程主循环。
+	 */
+	void worker_loop();
+
+	/**
+	 * @brief 不断领取并执行当前任务的子任务，直到全部领取完毕。
+	 */
+	void run_items(const std::function<void(int)>& task, int count);
+
+public:
+	/**
+	 * @brief 构造函数，创建线程池。
+	 * @param thread_count 参与计算的线程总数（包括调用线程）。小于等于 0 时使用硬件并发数。
+	 */
+	explicit ThreadPool(int thread_count);
+
+	/**
+	 * @brief 析构函数，通知并等待所有工作线程退出。
+	 */
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * @brief 返回参与计算的线程总数（包括调用线程）。
+	 */
+	int size() const;
+
+	/**
+	 * @brief 并行执行 task(0) ... task(count - 1)，调用线程也会参与计算，返回时所有子任务都已完成。
+	 *
+	 * 子任务的执行顺序和所在线程都不确定，task 必须只写互不重叠的数据。
+	 * 如果某个子任务抛出异常，会在所有子任务结束后于调用线程中重新抛出。
+	 *
+	 * @param count 子任务数量。
+	 * @param task 子任务函数，参数为子任务编号。
+	 */
+	void parallel_for(int count, const std::function<void(int)>& task);
+};
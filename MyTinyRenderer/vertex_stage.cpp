@@ -0,0 +1,130 @@
+#include "vertex_stage.h"
+#include "simd_target.h"
+
+namespace rst {
+
+	void VertexStream::resize(int count) {
+		int padded = (count + vertex_batch - 1) / vertex_batch * vertex_batch;
+		for (int k = 0; k < 4; k++) {
+			position[k].assign(padded, k == 3 ? 1.f : 0.f);
+			clip[k].resize(padded);
+		}
+		for (int k = 0; k < 3; k++) {
+			screen[k].resize(padded);
+			view[k].resize(padded);
+		}
+	}
+
+	VertexTransform make_vertex_transform(const Mat4f& mv, const Mat4f& mvp, const Vec3f& viewport_scale, const Vec3f& viewport_bias, const Vec3f& viewport_offset) {
+		VertexTransform xf;
+		for (int r = 0; r < 4; r++) {
+			const Vec4f row_mv = mv[r];
+			const Vec4f row_mvp = mvp[r];
+			const float a[4] = { row_mv.x, row_mv.y, row_mv.z, row_mv.w };
+			const float b[4] = { row_mvp.x, row_mvp.y, row_mvp.z, row_mvp.w };
+			for (int c = 0; c < 4; c++) {
+				xf.mv[4 * r + c] = a[c];
+				xf.mvp[4 * r + c] = b[c];
+			}
+		}
+		const Vec3f* viewport[3] = { &viewport_scale, &viewport_bias, &viewport_offset };
+		float* dst[3] = { xf.viewport_scale, xf.viewport_bias, xf.viewport_offset };
+		for (int k = 0; k < 3; k++) {
+			dst[k][0] = viewport[k]->x;
+			dst[k][1] = viewport[k]->y;
+			dst[k][2] = viewport[k]->z;
+		}
+		return xf;
+	}
+
+	/*
+	 * 所有实现都按同样的顺序计算，没有使用 FMA，结果逐位一致：
+	 *   clip   = ((mvp[r][0] * x + mvp[r][1] * y) + mvp[r][2] * z) + mvp[r][3] * w
+	 *   view   = ((mv[r][0] * x + mv[r][1] * y) + mv[r][2] * z) + mv[r][3] * w
+	 *   ndc    = clip / clip.w
+	 *   screen = (ndc * scale + bias) + offset
+	 */
+
+	static void vertex_kernel_scalar(const VertexTransform& xf, VertexStream& s, int count) {
+		for (int i = 0; i < count; i++) {
+			const float p[4] = { s.position[0][i], s.position[1][i], s.position[2][i], s.position[3][i] };
+			float c[4];
+			for (int r = 0; r < 4; r++) {
+				const float* m = xf.mvp + 4 * r;
+				c[r] = m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3] * p[3];
+				s.clip[r][i] = c[r];
+			}
+			for (int r = 0; r < 3; r++) {
+				const float* m = xf.mv + 4 * r;
+				s.view[r][i] = m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3] * p[3];
+				float n = c[r] / c[3];
+				s.screen[r][i] = n * xf.viewport_scale[r] + xf.viewport_bias[r] + xf.viewport_offset[r];
+			}
+		}
+	}
+
+#ifdef RST_X86
+	static inline __m128 transform_row_sse2(const float* m, __m128 x, __m128 y, __m128 z, __m128 w) {
+		__m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), x), _mm_mul_ps(_mm_set1_ps(m[1]), y));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m[2]), z));
+		return _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m[3]), w));
+	}
+
+	static void vertex_kernel_sse2(const VertexTransform& xf, VertexStream& s, int count) {
+		for (int i = 0; i < count; i += 4) {
+			const __m128 x = _mm_loadu_ps(s.position[0].data() + i);
+			const __m128 y = _mm_loadu_ps(s.position[1].data() + i);
+			const __m128 z = _mm_loadu_ps(s.position[2].data() + i);
+			const __m128 w = _mm_loadu_ps(s.position[3].data() + i);
+			__m128 c[4];
+			for (int r = 0; r < 4; r++) {
+				c[r] = transform_row_sse2(xf.mvp + 4 * r, x, y, z, w);
+				_mm_storeu_ps(s.clip[r].data() + i, c[r]);
+			}
+			for (int r = 0; r < 3; r++) {
+				_mm_storeu_ps(s.view[r].data() + i, transform_row_sse2(xf.mv + 4 * r, x, y, z, w));
+				__m128 n = _mm_div_ps(c[r], c[3]);
+				__m128 sc = _mm_add_ps(_mm_mul_ps(n, _mm_set1_ps(xf.viewport_scale[r])), _mm_set1_ps(xf.viewport_bias[r]));
+				_mm_storeu_ps(s.screen[r].data() + i, _mm_add_ps(sc, _mm_set1_ps(xf.viewport_offset[r])));
+			}
+		}
+	}
+
+	RST_TARGET_AVX
+	static inline __m256 transform_row_avx(const float* m, __m256 x, __m256 y, __m256 z, __m256 w) {
+		__m256 r = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0]), x), _mm256_mul_ps(_mm256_set1_ps(m[1]), y));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(m[2]), z));
+		return _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(m[3]), w));
+	}
+
+	RST_TARGET_AVX
+	static void vertex_kernel_avx(const VertexTransform& xf, VertexStream& s, int count) {
+		for (int i = 0; i < count; i += vertex_batch) {
+			const __m256 x = _mm256_loadu_ps(s.position[0].data() + i);
+			const __m256 y = _mm256_loadu_ps(s.position[1].data() + i);
+			const __m256 z = _mm256_loadu_ps(s.position[2].data() + i);
+			const __m256 w = _mm256_loadu_ps(s.position[3].data() + i);
+			__m256 c[4];
+			for (int r = 0; r < 4; r++) {
+				c[r] = transform_row_avx(xf.mvp + 4 * r, x, y, z, w);
+				_mm256_storeu_ps(s.clip[r].data() + i, c[r]);
+			}
+			for (int r = 0; r < 3; r++) {
+				_mm256_storeu_ps(s.view[r].data() + i, transform_row_avx(xf.mv + 4 * r, x, y, z, w));
+				__m256 n = _mm256_div_ps(c[r], c[3]);
+				__m256 sc = _mm256_add_ps(_mm256_mul_ps(n, _mm256_set1_ps(xf.viewport_scale[r])), _mm256_set1_ps(xf.viewport_bias[r]));
+				_mm256_storeu_ps(s.screen[r].data() + i, _mm256_add_ps(sc, _mm256_set1_ps(xf.viewport_offset[r])));
+			}
+		}
+	}
+#endif
+
+	VertexKernel select_vertex_kernel(SimdLevel level) {
+#ifdef RST_X86
+		if (level == SimdLevel::AVX) return vertex_kernel_avx;
+		if (level == SimdLevel::SSE2) return vertex_kernel_sse2;
+#endif
+		return vertex_kernel_scalar;
+	}
+
+} // namespace rst
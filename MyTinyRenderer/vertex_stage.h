@@ -0,0 +1,95 @@
+/**
+
+@file vertex_stage.h
+@brief 顶点处理阶段：每次绘制只计算一次 MV/MVP 矩阵，然后把整个顶点数组按结构体数组（SoA）分批做 SIMD 变换，
+一遍得到裁剪空间、屏幕空间和视图空间坐标。
+*/
+#pragma once
+
+#include <vector>
+
+#include "geometry.h"
+#include "raster_kernel.h"
+
+namespace rst {
+
+	/**
+
+	@brief 顶点内核一批处理的顶点数。顶点流的长度总是补齐到它的整数倍，内核不需要处理尾部。
+	*/
+	constexpr int vertex_batch = 8;
+
+	/**
+
+	@brief 一次绘制的变换参数，矩阵按行优先展开。
+	*/
+	struct VertexTransform
+	{
+		float mv[16]; // 模型视图矩阵，把模型空间坐标变换到视图空间
+		float mvp[16]; // 模型视图投影矩阵，把模型空间坐标变换到裁剪空间
+		float viewport_scale[3]; // 视口变换：screen = (ndc * viewport_scale + viewport_bias) + viewport_offset
+		float viewport_bias[3];
+		float viewport_offset[3];
+	};
+
+	/**
+
+	@brief 按 SoA 排列的顶点流，每个分量单独存放，方便一次读写一批顶点。
+	*/
+	struct VertexStream
+	{
+		std::vector<float> position[4]; // 输入：模型空间齐次坐标 x、y、z、w
+		std::vector<float> clip[4]; // 输出：裁剪空间坐标 x、y、z、w
+		std::vector<float> screen[3]; // 输出：视口变换后的屏幕坐标 x、y、z
+		std::vector<float> view[3]; // 输出：视图空间坐标 x、y、z
+
+		/**
+		 * @brief 设置顶点数，并把长度补齐到 vertex_batch 的整数倍。补齐部分的输入是 (0, 0, 0, 1)。
+		 * @param count 顶点数。
+		 */
+		void resize(int count);
+
+		/**
+		 * @brief 补齐后的长度，是 vertex_batch 的整数倍。
+		 */
+		int padded_size() const { return static_cast<int>(position[0].size()); }
+
+		void set_position(int i, const Vec4f& p)
+		{
+			position[0][i] = p.x;
+			position[1][i] = p.y;
+			position[2][i] = p.z;
+			position[3][i] = p.w;
+		}
+
+		Vec4f clip_position(int i) const { return Vec4f(clip[0][i], clip[1][i], clip[2][i], clip[3][i]); }
+
+		/**
+		 * @brief 屏幕空间坐标，w 分量保留裁剪空间的 w，供透视校正插值使用。
+		 */
+		Vec4f screen_position(int i) const { return Vec4f(screen[0][i], screen[1][i], screen[2][i], clip[3][i]); }
+
+		Vec3f view_position(int i) const { return Vec3f(view[0][i], view[1][i], view[2][i]); }
+	};
+
+	/**
+
+	@brief 顶点内核函数类型：变换顶点流中的前 count 个顶点，count 必须是 vertex_batch 的整数倍。
+	矩阵与向量相乘按 ((m0 * x + m1 * y) + m2 * z) + m3 * w 的顺序累加，与 Mat4f::operator* 的结果逐位一致。
+	*/
+	using VertexKernel = void (*)(const VertexTransform& xf, VertexStream& stream, int count);
+
+	/**
+
+	@brief 返回指定级别的顶点内核。
+	@param level 指令集级别，超出当前编译目标支持范围时退化为标量实现。
+	*/
+	VertexKernel select_vertex_kernel(SimdLevel level);
+
+	/**
+
+	@brief 由模型视图矩阵、模型视图投影矩阵和视口参数填写变换参数。
+	*/
+	VertexTransform make_vertex_transform(const Mat4f& mv, const Mat4f& mvp, const Vec3f& viewport_scale, const Vec3f& viewport_bias, const Vec3f& viewport_offset);
+
+} // namespace rst